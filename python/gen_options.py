@@ -2,8 +2,8 @@
 import sys
 
 # Script for configuring the Python module at compile-time.
-if len(sys.argv) != 5:
-    print("usage: %s <options.file> <binpath> <module.in> <module.out>" % sys.argv[0])
+if len(sys.argv) != 6:
+    print("usage: %s <options.file> <binpath> <libpath> <module.in> <module.out>" % sys.argv[0])
     sys.exit(0)
 
 options = []
@@ -36,7 +36,7 @@ keyargs = "keyargs = set([\n" + '\n'.join(keyargs) + "    ])"
 conversion = {
     "file": "str", "chars": "str", "num": "int", "bool": "bool",
     "start:end": "str", "blocks:id": "str", "name": "str",
-    "type": "str", "": "bool"
+    "type": "str", "value": "float", "stages": "str", "": "bool"
 }
 
 # Prepare usage
@@ -59,10 +59,11 @@ for opt in options:
 
 
 # Replace
-f = open(sys.argv[4], 'w')
-for line in open(sys.argv[3]):
+f = open(sys.argv[5], 'w')
+for line in open(sys.argv[4]):
     line = line.replace('%KEYARGS%', keyargs)
     line = line.replace('%USAGE%', usage)
     line = line.replace('%BINDIR%', sys.argv[2])
+    line = line.replace('%LIBDIR%', sys.argv[3])
     f.write(line)
 f.close()
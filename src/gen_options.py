@@ -40,6 +40,8 @@ shortopts += '"\n'
 # Prepare usage
 space = 11 * ' '
 usage = 'printf("Usage: harry [options] <input> [<input>] <output>\\n"\n'
+usage += '%s"       harry [options] --merge <part> ... <output>\\n"\n' % space
+usage += '%s"       harry [options] --serve <socket> <input>\\n"\n' % space
 for opt in options:
     # Headings
     if len(opt[0]) == 0:
@@ -0,0 +1,369 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+/**
+ * @defgroup bench Benchmarking
+ * Functions for benchmarking a similarity measure on random pairs of
+ * strings. Each thread draws pairs with its own random number generator
+ * and keeps its own counters, such that no locks are taken while
+ * measuring. After a warmup phase, the benchmark is repeated in several
+ * trials. The latencies of the comparisons are collected in a histogram
+ * with logarithmic bins, which provides percentiles with a relative
+ * error of about 6%.
+ * @author Konrad Rieck (konrad@mlsec.org)
+ * @{
+ */
+
+#include "config.h"
+#include "common.h"
+#include "util.h"
+#include "hbench.h"
+
+#include <time.h>
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Return the time of a monotonic clock
+ * @return time in nanoseconds
+ */
+static inline uint64_t time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Draw a random number (xorshift64*)
+ * @param x State of generator
+ * @return random number
+ */
+static inline uint64_t next_rand(uint64_t *x)
+{
+    *x ^= *x >> 12;
+    *x ^= *x << 25;
+    *x ^= *x >> 27;
+    return (*x * 0x2545F4914F6CDD1DULL) >> 11;
+}
+
+/**
+ * Return the position of the highest set bit
+ * @param x Value (not zero)
+ * @return position of bit
+ */
+static inline int high_bit(uint64_t x)
+{
+    int b = 0;
+    while (x >>= 1)
+        b++;
+    return b;
+}
+
+/**
+ * Determine the bin of a latency in the histogram. Small latencies
+ * have a bin of their own, larger ones are split into 8 bins per
+ * power of two.
+ * @param x Latency in nanoseconds
+ * @return bin of histogram
+ */
+static inline int latency_bin(uint64_t x)
+{
+    int b;
+
+    if (x < BENCH_SUBBINS)
+        return (int) x;
+
+    b = high_bit(x);
+    return (b - 2) * BENCH_SUBBINS + ((x >> (b - 3)) & (BENCH_SUBBINS - 1));
+}
+
+/**
+ * Return the center of a bin of the histogram
+ * @param k Bin of histogram
+ * @return latency in nanoseconds
+ */
+static double bin_center(int k)
+{
+    int b = k / BENCH_SUBBINS + 2;
+    double w;
+
+    if (k < BENCH_SUBBINS)
+        return k;
+
+    w = ldexp(1, b - 3);
+    return (BENCH_SUBBINS + k % BENCH_SUBBINS) * w + w / 2;
+}
+
+/**
+ * Determine the bucket of a pair of strings from its average length
+ * @param x First string
+ * @param y Second string
+ * @return bucket of lengths
+ */
+static inline int length_bucket(hstring_t x, hstring_t y)
+{
+    return MIN(high_bit((x.len + y.len) / 2 + 1), BENCH_BUCKETS - 1);
+}
+
+/**
+ * Add the counters of one thread to other counters
+ * @param a Counters to add to
+ * @param b Counters of thread
+ */
+static void count_add(hcount_t *a, hcount_t *b)
+{
+    int k;
+
+    a->cmps += b->cmps;
+    a->nsecs += b->nsecs;
+    a->max = MAX(a->max, b->max);
+    for (k = 0; k < BENCH_BINS; k++)
+        a->hist[k] += b->hist[k];
+    for (k = 0; k < BENCH_BUCKETS; k++) {
+        a->bcmps[k] += b->bcmps[k];
+        a->bnsecs[k] += b->bnsecs[k];
+    }
+}
+
+/**
+ * Run one trial of the benchmark. Each thread compares random pairs of
+ * strings until the time is up. The latency of a comparison includes
+ * drawing the pair, as only one clock is read per comparison.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param t Time of trial in seconds
+ * @param cnt Counters of threads
+ * @param nt Number of threads
+ * @param seed Seed of random number generators
+ * @return elapsed time in seconds
+ */
+static double run_trial(hmatrix_t *m, hstring_t *s,
+                        double (*measure) (hstring_t, hstring_t),
+                        double t, hcount_t *cnt, int nt, uint64_t seed)
+{
+    uint64_t start = time_ns(), end = start + (uint64_t) (t * 1e9);
+    long cl = m->col.end - m->col.start, rl = m->row.end - m->row.start;
+
+    memset(cnt, 0, nt * sizeof(hcount_t));
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(nt)
+#endif
+    {
+        int id = 0;
+#ifdef HAVE_OPENMP
+        id = omp_get_thread_num();
+#endif
+        hcount_t *tc = cnt + id;
+        uint64_t x = seed * 0x9E3779B97F4A7C15ULL + id + 1, t0, t1, d;
+        long c, r;
+        int b;
+
+        for (t1 = time_ns(); t1 < end;) {
+            t0 = t1;
+            c = m->col.start + (long) (next_rand(&x) % cl);
+            r = m->row.start + (long) (next_rand(&x) % rl);
+
+            measure(s[c], s[r]);
+
+            t1 = time_ns();
+            d = t1 - t0;
+            b = length_bucket(s[c], s[r]);
+            tc->cmps++;
+            tc->nsecs += d;
+            tc->max = MAX(tc->max, d);
+            tc->hist[latency_bin(d)]++;
+            tc->bcmps[b]++;
+            tc->bnsecs[b] += d;
+        }
+    }
+
+    return (time_ns() - start) / 1e9;
+}
+
+/**
+ * Benchmark a similarity measure on random pairs of strings. The pairs
+ * are drawn from the column and row ranges of the matrix. A warmup of
+ * a tenth of the time, but at most one second, precedes the trials.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param t Time of all trials in seconds
+ * @param trials Number of trials
+ * @return results of benchmark or NULL on error
+ */
+hbench_t *hbench_run(hmatrix_t *m, hstring_t *s,
+                     double (*measure) (hstring_t, hstring_t),
+                     double t, int trials)
+{
+    hbench_t *b;
+    hcount_t *cnt, sum;
+    double el;
+    int i, k;
+
+    assert(m && s && trials > 0);
+
+    b = calloc(1, sizeof(hbench_t));
+    if (!b) {
+        error("Could not allocate benchmark");
+        return NULL;
+    }
+
+    b->threads = 1;
+#ifdef HAVE_OPENMP
+    b->threads = omp_get_max_threads();
+#endif
+    b->trials = trials;
+    b->seconds = t / trials;
+    b->warmup = MIN(1.0, t / 10);
+
+    b->rates = calloc(trials, sizeof(double));
+    b->cmps = calloc(trials, sizeof(uint64_t));
+    cnt = calloc(b->threads, sizeof(hcount_t));
+    if (!b->rates || !b->cmps || !cnt) {
+        error("Could not allocate benchmark");
+        free(cnt);
+        hbench_destroy(b);
+        return NULL;
+    }
+
+    /* Warm up caches and clock rate */
+    run_trial(m, s, measure, b->warmup, cnt, b->threads, 0);
+
+    for (i = 0; i < trials; i++) {
+        el = run_trial(m, s, measure, b->seconds, cnt, b->threads, i + 1);
+
+        memset(&sum, 0, sizeof(sum));
+        for (k = 0; k < b->threads; k++)
+            count_add(&sum, cnt + k);
+        count_add(&b->total, &sum);
+
+        b->cmps[i] = sum.cmps;
+        b->rates[i] = sum.cmps / el;
+        info_msg(2, "Trial %d: %lu comparisons; %.0f comparisons/s.",
+                 i + 1, (unsigned long) sum.cmps, b->rates[i]);
+    }
+
+    free(cnt);
+    return b;
+}
+
+/**
+ * Return the mean number of comparisons per second over all trials
+ * @param b Results of benchmark
+ * @return comparisons per second
+ */
+double hbench_rate(hbench_t *b)
+{
+    double r = 0;
+
+    for (int i = 0; i < b->trials; i++)
+        r += b->rates[i];
+
+    return r / b->trials;
+}
+
+/**
+ * Return a percentile of the latencies of all comparisons
+ * @param b Results of benchmark
+ * @param q Percentile in [0,1]
+ * @return latency in nanoseconds
+ */
+double hbench_latency(hbench_t *b, double q)
+{
+    uint64_t n = 0, k = (uint64_t) ceil(q * b->total.cmps);
+
+    if (b->total.cmps == 0)
+        return NAN;
+
+    for (int i = 0; i < BENCH_BINS; i++) {
+        n += b->total.hist[i];
+        if (n >= MAX(k, 1))
+            return MIN(bin_center(i), b->total.max);
+    }
+
+    return b->total.max;
+}
+
+/**
+ * Write the results of a benchmark in JSON format
+ * @param b Results of benchmark
+ * @param f File stream
+ * @param measure Name of similarity measure
+ */
+void hbench_json(hbench_t *b, FILE *f, const char *measure)
+{
+    double mean = hbench_rate(b), var = 0, lo = INFINITY, hi = 0;
+    hcount_t *t = &b->total;
+    int i, first = TRUE;
+
+    for (i = 0; i < b->trials; i++) {
+        var += pow(b->rates[i] - mean, 2) / b->trials;
+        lo = MIN(lo, b->rates[i]);
+        hi = MAX(hi, b->rates[i]);
+    }
+
+    fprintf(f, "{\n  \"measure\": \"%s\",\n", measure);
+    fprintf(f, "  \"threads\": %d,\n  \"warmup\": %g,\n", b->threads,
+            b->warmup);
+    fprintf(f, "  \"seconds\": %g,\n  \"comparisons\": %lu,\n",
+            b->seconds * b->trials, (unsigned long) t->cmps);
+
+    fprintf(f, "  \"trials\": [");
+    for (i = 0; i < b->trials; i++)
+        fprintf(f, "%s\n    {\"comparisons\": %lu, \"rate\": %.1f}",
+                i ? "," : "", (unsigned long) b->cmps[i], b->rates[i]);
+    fprintf(f, "\n  ],\n");
+
+    fprintf(f, "  \"rate\": {\"mean\": %.1f, \"stddev\": %.1f, "
+            "\"min\": %.1f, \"max\": %.1f},\n", mean, sqrt(var), lo, hi);
+
+    fprintf(f, "  \"latency_ns\": {\"mean\": %.1f, \"p50\": %.0f, "
+            "\"p90\": %.0f, \"p99\": %.0f, \"p999\": %.0f, \"max\": %lu},\n",
+            t->cmps ? (double) t->nsecs / t->cmps : 0,
+            hbench_latency(b, 0.5), hbench_latency(b, 0.9),
+            hbench_latency(b, 0.99), hbench_latency(b, 0.999),
+            (unsigned long) t->max);
+
+    /* Buckets of average string lengths */
+    fprintf(f, "  \"lengths\": [");
+    for (i = 0; i < BENCH_BUCKETS; i++) {
+        if (t->bcmps[i] == 0)
+            continue;
+        fprintf(f, "%s\n    {\"min\": %lu, \"max\": %lu, "
+                "\"comparisons\": %lu, \"mean_ns\": %.1f}",
+                first ? "" : ",", (1UL << i) - 1, (2UL << i) - 2,
+                (unsigned long) t->bcmps[i],
+                (double) t->bnsecs[i] / t->bcmps[i]);
+        first = FALSE;
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+/**
+ * Destroy the results of a benchmark
+ * @param b Results of benchmark
+ */
+void hbench_destroy(hbench_t *b)
+{
+    if (!b)
+        return;
+
+    free(b->rates);
+    free(b->cmps);
+    free(b);
+}
+
+/** @} */
@@ -0,0 +1,60 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef HBENCH_H
+#define HBENCH_H
+
+#include "hmatrix.h"
+
+/* Bins of latency histogram: 8 bins per power of two */
+#define BENCH_SUBBINS   8
+#define BENCH_BINS      (64 * BENCH_SUBBINS)
+
+/* Buckets of string lengths: one bucket per power of two */
+#define BENCH_BUCKETS   32
+
+/**
+ * Counters of a benchmark. Each thread holds its own counters that
+ * are merged after each trial.
+ */
+typedef struct
+{
+    uint64_t cmps;                      /**< Number of comparisons */
+    uint64_t nsecs;                     /**< Time of comparisons (ns) */
+    uint64_t max;                       /**< Maximum latency (ns) */
+    uint64_t hist[BENCH_BINS];          /**< Histogram of latencies */
+    uint64_t bcmps[BENCH_BUCKETS];      /**< Comparisons per bucket */
+    uint64_t bnsecs[BENCH_BUCKETS];     /**< Time per bucket (ns) */
+} hcount_t;
+
+/**
+ * Results of a benchmark
+ */
+typedef struct
+{
+    int threads;        /**< Number of threads */
+    int trials;         /**< Number of trials */
+    double seconds;     /**< Time of each trial in seconds */
+    double warmup;      /**< Time of warmup in seconds */
+    double *rates;      /**< Comparisons per second of each trial */
+    uint64_t *cmps;     /**< Comparisons of each trial */
+    hcount_t total;     /**< Counters of all trials */
+} hbench_t;
+
+hbench_t *hbench_run(hmatrix_t *, hstring_t *,
+                     double (*measure) (hstring_t, hstring_t),
+                     double, int);
+double hbench_rate(hbench_t *);
+double hbench_latency(hbench_t *, double);
+void hbench_json(hbench_t *, FILE *, const char *);
+void hbench_destroy(hbench_t *);
+
+#endif /* HBENCH_H */
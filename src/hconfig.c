@@ -21,6 +21,7 @@
 #include "common.h"
 #include "util.h"
 #include "hconfig.h"
+#include "murmur.h"
 
 #define I "input"
 #define M "measures"
@@ -42,24 +43,41 @@ static default_t defaults[] = {
     {M "", "num_threads", CONFIG_TYPE_INT, {.num = 0}},
     {M "", "cache_size", CONFIG_TYPE_INT, {.num = 256}},
     {M "", "global_cache", CONFIG_TYPE_BOOL, {.num = CONFIG_FALSE}},
+    {M "", "dedup", CONFIG_TYPE_BOOL, {.num = CONFIG_FALSE}},
     {M "", "col_range", CONFIG_TYPE_STRING, {.str = ""}},
     {M "", "row_range", CONFIG_TYPE_STRING, {.str = ""}},
     {M "", "split", CONFIG_TYPE_STRING, {.str = ""}},
+    {M "", "storage", CONFIG_TYPE_STRING, {.str = "float"}},
+    {M "", "row_block", CONFIG_TYPE_INT, {.num = 0}},
+    {M "", "mmap_file", CONFIG_TYPE_STRING, {.str = ""}},
+    {M "", "mmap_sync", CONFIG_TYPE_INT, {.num = 300}},
+    {M "", "extend_file", CONFIG_TYPE_STRING, {.str = ""}},
+    {M "", "knn", CONFIG_TYPE_INT, {.num = 0}},
+    {M "", "threshold", CONFIG_TYPE_STRING, {.str = ""}},
+    {M "", "filter", CONFIG_TYPE_STRING, {.str = ""}},
+    {M "", "index_file", CONFIG_TYPE_STRING, {.str = ""}},
+    {M "", "graph_links", CONFIG_TYPE_INT, {.num = 0}},
+    {M "", "graph_build", CONFIG_TYPE_INT, {.num = 100}},
+    {M "", "graph_search", CONFIG_TYPE_INT, {.num = 50}},
+    {M "", "graph_recall", CONFIG_TYPE_INT, {.num = 0}},
     {M ".dist_hamming", "norm", CONFIG_TYPE_STRING, {.str = "none"}},
     {M ".dist_levenshtein", "norm", CONFIG_TYPE_STRING, {.str = "none"}},
     {M ".dist_levenshtein", "cost_ins", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
     {M ".dist_levenshtein", "cost_del", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
     {M ".dist_levenshtein", "cost_sub", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
+    {M ".dist_levenshtein", "max_dist", CONFIG_TYPE_FLOAT, {.flt = 0.0}},
     {M ".dist_damerau", "norm", CONFIG_TYPE_STRING, {.str = "none"}},
     {M ".dist_damerau", "cost_ins", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
     {M ".dist_damerau", "cost_del", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
     {M ".dist_damerau", "cost_sub", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
     {M ".dist_damerau", "cost_tra", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
+    {M ".dist_damerau", "max_dist", CONFIG_TYPE_FLOAT, {.flt = 0.0}},
     {M ".dist_osa", "norm", CONFIG_TYPE_STRING, {.str = "none"}},
     {M ".dist_osa", "cost_ins", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
     {M ".dist_osa", "cost_del", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
     {M ".dist_osa", "cost_sub", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
     {M ".dist_osa", "cost_tra", CONFIG_TYPE_FLOAT, {.flt = 1.0}},
+    {M ".dist_osa", "max_dist", CONFIG_TYPE_FLOAT, {.flt = 0.0}},
     {M ".dist_jarowinkler", "scaling", CONFIG_TYPE_FLOAT, {.flt = 0.1}},
     {M ".dist_lee", "min_sym", CONFIG_TYPE_INT, {.num = 0}},
     {M ".dist_lee", "max_sym", CONFIG_TYPE_INT, {.num = 255}},
@@ -160,6 +178,88 @@ void config_fprint(FILE *f, config_t * cfg)
     config_setting_fprint(f, config_root_setting(cfg), 0);
 }
 
+/* Settings that do not influence the similarity values */
+static char *transient[] = {
+    "input.chunk_size", "measures.num_threads", "measures.cache_size",
+    "measures.global_cache", "measures.dedup", "measures.col_range",
+    "measures.row_range", "measures.split", "measures.row_block",
+    "measures.mmap_file", "measures.mmap_sync", "measures.extend_file",
+    "measures.knn", "measures.threshold", "measures.filter",
+    "measures.index_file", "measures.graph_links", "measures.graph_build",
+    "measures.graph_search", "measures.graph_recall", NULL
+};
+
+/**
+ * Compute a hash over a configuration setting. Each value is hashed
+ * together with its path, such that the order of settings is irrelevant.
+ * @param cs Configuration setting
+ * @param p Path of setting
+ * @return hash value
+ */
+static uint64_t config_setting_hash(config_setting_t * cs, char *p)
+{
+    char buf[1024];
+    uint64_t h = 0;
+    int i, l;
+
+    for (i = 0; transient[i]; i++)
+        if (!strcmp(p, transient[i]))
+            return 0;
+
+    switch (config_setting_type(cs)) {
+    case CONFIG_TYPE_GROUP:
+        for (i = 0; i < config_setting_length(cs); i++) {
+            config_setting_t *e = config_setting_get_elem(cs, i);
+            snprintf(buf, sizeof(buf), "%s%s%s", p, strlen(p) ? "." : "",
+                     config_setting_name(e));
+            h ^= config_setting_hash(e, buf);
+        }
+        return h;
+    case CONFIG_TYPE_STRING:
+        l = snprintf(buf, sizeof(buf), "%s=%s", p,
+                     config_setting_get_string(cs));
+        break;
+    case CONFIG_TYPE_FLOAT:
+        l = snprintf(buf, sizeof(buf), "%s=%.17g", p,
+                     config_setting_get_float(cs));
+        break;
+    case CONFIG_TYPE_INT:
+        l = snprintf(buf, sizeof(buf), "%s=%ld", p,
+                     (long) config_setting_get_int(cs));
+        break;
+    case CONFIG_TYPE_BOOL:
+        l = snprintf(buf, sizeof(buf), "%s=%d", p,
+                     config_setting_get_bool(cs));
+        break;
+    default:
+        return 0;
+    }
+
+    return MurmurHash64B(buf, MIN(l, (int) sizeof(buf) - 1), 0xc0ffee);
+}
+
+/**
+ * Compute a fingerprint of the configuration. Only the settings of
+ * the input and measures groups that influence the similarity values
+ * are considered. The output group is ignored.
+ * @param cfg configuration
+ * @return fingerprint
+ */
+uint64_t config_fingerprint(config_t * cfg)
+{
+    config_setting_t *cs;
+    uint64_t h = 0;
+
+    cs = config_lookup(cfg, "input");
+    if (cs)
+        h ^= config_setting_hash(cs, "input");
+    cs = config_lookup(cfg, "measures");
+    if (cs)
+        h ^= config_setting_hash(cs, "measures");
+
+    return h;
+}
+
 /**
  * The functions add default values to unspecified parameters.
  * @param cfg configuration
@@ -0,0 +1,831 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+/**
+ * @defgroup graph Navigable small-world graph
+ * Functions for approximating nearest neighbors with a hierarchical
+ * navigable small-world graph (Malkov and Yashunin, 2018). The graph is
+ * built over the strings of the column range using the similarity measure
+ * as the only oracle and is searched greedily for each string of the row
+ * range. In contrast to the metric index, the measure need not be a
+ * metric, yet neighbors may be missed. The number of links and the number
+ * of candidates during building and searching trade run-time for recall.
+ * @author Konrad Rieck (konrad@mlsec.org)
+ * @{
+ */
+
+#include "config.h"
+#include "common.h"
+#include "util.h"
+#include "hgraph.h"
+
+/* External variables */
+extern int verbose;
+
+/* Locking of nodes and entry point */
+#ifdef HAVE_OPENMP
+#define NODE_LOCK(g, i)         omp_set_lock((g)->locks + (i))
+#define NODE_UNLOCK(g, i)       omp_unset_lock((g)->locks + (i))
+#define ENTRY_LOCK(g)           omp_set_lock(&(g)->lock)
+#define ENTRY_UNLOCK(g)         omp_unset_lock(&(g)->lock)
+#else
+#define NODE_LOCK(g, i)
+#define NODE_UNLOCK(g, i)
+#define ENTRY_LOCK(g)
+#define ENTRY_UNLOCK(g)
+#endif
+
+/**
+ * State of a search. Each thread uses its own state.
+ */
+typedef struct
+{
+    hlink_t *cand;      /**< Candidates (heap with closest on top) */
+    long ncand;         /**< Number of candidates */
+    long scand;         /**< Capacity of candidates */
+    hlink_t *res;       /**< Results (heap with farthest on top) */
+    long nres;          /**< Number of results */
+    hlink_t *buf;       /**< Copy of links of a node */
+    hlink_t *sel;       /**< Selected links */
+    long *pruned;       /**< Pruned candidates during selection */
+    uint32_t *mark;     /**< Marks of visited nodes */
+    uint32_t gen;       /**< Current mark */
+    long calcs;         /**< Computed comparisons */
+} search_t;
+
+/**
+ * Check whether a link is closer than another. Ties are broken by the
+ * node index as for the full computation of nearest neighbors.
+ * @param a First link
+ * @param b Second link
+ * @return true if a is closer than b
+ */
+static inline int link_closer(hlink_t a, hlink_t b)
+{
+    if (a.dist != b.dist)
+        return a.dist < b.dist;
+    return a.id < b.id;
+}
+
+/**
+ * Compare two links by ascending distance
+ * @param x First link
+ * @param y Second link
+ * @return comparison result
+ */
+static int link_cmp(const void *x, const void *y)
+{
+    hlink_t a = *(hlink_t *) x, b = *(hlink_t *) y;
+    return link_closer(a, b) ? -1 : link_closer(b, a);
+}
+
+/**
+ * Add a link to a heap. The heap has the closest or farthest link on top.
+ * @param h Heap of links
+ * @param n Number of links in heap
+ * @param e Link to add
+ * @param far Flag for farthest link on top
+ */
+static void heap_push(hlink_t *h, long *n, hlink_t e, int far)
+{
+    long i;
+
+    for (i = (*n)++; i > 0; i = (i - 1) / 2) {
+        hlink_t p = h[(i - 1) / 2];
+        if (far ? !link_closer(p, e) : !link_closer(e, p))
+            break;
+        h[i] = p;
+    }
+    h[i] = e;
+}
+
+/**
+ * Remove the top link from a heap
+ * @param h Heap of links
+ * @param n Number of links in heap
+ * @param far Flag for farthest link on top
+ * @return top link
+ */
+static hlink_t heap_pop(hlink_t *h, long *n, int far)
+{
+    hlink_t top = h[0], e = h[--(*n)];
+    long i, j;
+
+    for (i = 0; (j = 2 * i + 1) < *n; i = j) {
+        if (j + 1 < *n && (far ? link_closer(h[j], h[j + 1]) :
+                           link_closer(h[j + 1], h[j])))
+            j++;
+        if (far ? !link_closer(e, h[j]) : !link_closer(h[j], e))
+            break;
+        h[i] = h[j];
+    }
+    h[i] = e;
+    return top;
+}
+
+/**
+ * Draw the level of a node. The levels are distributed geometrically and
+ * derived from the index of the node, such that the graph is
+ * reproducible.
+ * @param i Index of node
+ * @param ml Normalization of levels
+ * @return level
+ */
+static int node_level(long i, double ml)
+{
+    uint64_t x = (i + 1) * 0x9E3779B97F4A7C15ULL;
+    double u;
+
+    x ^= x >> 31;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 29;
+    u = ((x >> 11) + 1.0) / 9007199254740992.0;
+
+    return MIN((int) (-log(u) * ml), GRAPH_LEVELS - 1);
+}
+
+/**
+ * Return the maximum number of links of a level. The bottom level holds
+ * twice as many links as the levels above.
+ * @param g Graph
+ * @param l Level
+ * @return number of links
+ */
+static inline int level_links(hgraph_t *g, int l)
+{
+    return l == 0 ? 2 * g->links : g->links;
+}
+
+/**
+ * Compare two strings and convert the result to a distance. Similarity
+ * values are negated and NaN values are mapped to infinity.
+ * @param g Graph
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param x Index of first string
+ * @param y Index of second string
+ * @param st State of search
+ * @return distance
+ */
+static inline float graph_dist(hgraph_t *g, hstring_t *s,
+                               double (*measure) (hstring_t, hstring_t),
+                               long x, long y, search_t *st)
+{
+    float v = measure(s[x], s[y]);
+
+    st->calcs++;
+    if (isnan(v))
+        return INFINITY;
+    return g->descending ? -v : v;
+}
+
+/**
+ * Free the states of searches
+ * @param st Array of states
+ * @param num Number of states
+ */
+static void search_free(search_t *st, int num)
+{
+    for (int i = 0; i < num; i++) {
+        free(st[i].cand);
+        free(st[i].res);
+        free(st[i].buf);
+        free(st[i].sel);
+        free(st[i].pruned);
+        free(st[i].mark);
+    }
+    free(st);
+}
+
+/**
+ * Allocate the states of searches for all threads
+ * @param g Graph
+ * @param ef Maximum number of results
+ * @param num Number of states
+ * @return array of states or NULL on error
+ */
+static search_t *search_alloc(hgraph_t *g, long ef, int num)
+{
+    search_t *st = calloc(num, sizeof(search_t));
+    int i, ok = st != NULL;
+
+    for (i = 0; ok && i < num; i++) {
+        st[i].scand = MAX(ef, 16);
+        st[i].cand = malloc(st[i].scand * sizeof(hlink_t));
+        st[i].res = malloc((ef + 1) * sizeof(hlink_t));
+        st[i].buf = malloc(2 * g->links * sizeof(hlink_t));
+        st[i].sel = malloc(g->links * sizeof(hlink_t));
+        st[i].pruned = malloc(ef * sizeof(long));
+        st[i].mark = calloc(MAX(g->num, 1), sizeof(uint32_t));
+        ok = st[i].cand && st[i].res && st[i].buf && st[i].sel &&
+            st[i].pruned && st[i].mark;
+    }
+
+    if (!ok) {
+        error("Could not allocate state of search");
+        if (st)
+            search_free(st, num);
+        return NULL;
+    }
+
+    return st;
+}
+
+/**
+ * Start a search from an entry node
+ * @param g Graph
+ * @param st State of search
+ * @param e Entry node with distance
+ * @param self Node excluded from search or -1
+ */
+static void search_start(hgraph_t *g, search_t *st, hlink_t e, long self)
+{
+    /* Reset marks on overflow */
+    if (++st->gen == 0) {
+        memset(st->mark, 0, g->num * sizeof(uint32_t));
+        st->gen = 1;
+    }
+
+    st->ncand = st->nres = 0;
+    if (self >= 0)
+        st->mark[self] = st->gen;
+    st->mark[e.id] = st->gen;
+    heap_push(st->cand, &st->ncand, e, FALSE);
+    heap_push(st->res, &st->nres, e, TRUE);
+}
+
+/**
+ * Copy the links of a node on a level
+ * @param g Graph
+ * @param i Index of node
+ * @param l Level
+ * @param buf Buffer for links
+ * @return number of links
+ */
+static int links_copy(hgraph_t *g, long i, int l, hlink_t *buf)
+{
+    int n;
+
+    NODE_LOCK(g, i);
+    n = g->nodes[i].num[l];
+    memcpy(buf, g->nodes[i].links[l], n * sizeof(hlink_t));
+    NODE_UNLOCK(g, i);
+
+    return n;
+}
+
+/**
+ * Search greedily for the closest node on a level
+ * @param g Graph
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param q Index of query string
+ * @param e Entry node with distance
+ * @param l Level
+ * @param st State of search
+ * @return closest node with distance
+ */
+static hlink_t search_greedy(hgraph_t *g, hstring_t *s,
+                             double (*measure) (hstring_t, hstring_t),
+                             long q, hlink_t e, int l, search_t *st)
+{
+    int changed = TRUE, n, i;
+    hlink_t f;
+
+    while (changed) {
+        changed = FALSE;
+        n = links_copy(g, e.id, l, st->buf);
+        for (i = 0; i < n; i++) {
+            f.id = st->buf[i].id;
+            f.dist = graph_dist(g, s, measure, g->base + f.id, q, st);
+            if (link_closer(f, e)) {
+                e = f;
+                changed = TRUE;
+            }
+        }
+    }
+
+    return e;
+}
+
+/**
+ * Add a candidate to a search
+ * @param st State of search
+ * @param e Candidate with distance
+ */
+static void cand_add(search_t *st, hlink_t e)
+{
+    hlink_t *p;
+
+    if (st->ncand == st->scand) {
+        p = realloc(st->cand, 2 * st->scand * sizeof(hlink_t));
+        if (!p) {
+            error("Could not allocate candidates of search");
+            return;
+        }
+        st->cand = p;
+        st->scand *= 2;
+    }
+
+    heap_push(st->cand, &st->ncand, e, FALSE);
+}
+
+/**
+ * Search for the closest nodes on a level (beam search). The results are
+ * left in the state of the search.
+ * @param g Graph
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param q Index of query string
+ * @param l Level
+ * @param ef Maximum number of results
+ * @param st State of search
+ */
+static void search_level(hgraph_t *g, hstring_t *s,
+                         double (*measure) (hstring_t, hstring_t),
+                         long q, int l, long ef, search_t *st)
+{
+    hlink_t e, f;
+    int n, i;
+
+    while (st->ncand > 0) {
+        e = heap_pop(st->cand, &st->ncand, FALSE);
+        if (st->nres >= ef && link_closer(st->res[0], e))
+            break;
+
+        n = links_copy(g, e.id, l, st->buf);
+        for (i = 0; i < n; i++) {
+            f.id = st->buf[i].id;
+            if (st->mark[f.id] == st->gen)
+                continue;
+            st->mark[f.id] = st->gen;
+
+            f.dist = graph_dist(g, s, measure, g->base + f.id, q, st);
+            if (st->nres < ef || link_closer(f, st->res[0])) {
+                cand_add(st, f);
+                heap_push(st->res, &st->nres, f, TRUE);
+                if (st->nres > ef)
+                    heap_pop(st->res, &st->nres, TRUE);
+            }
+        }
+    }
+}
+
+/**
+ * Select the links of a node from sorted candidates. A candidate is
+ * skipped if it is closer to a selected link than to the node, such that
+ * the links point in different directions. Skipped candidates fill up
+ * the remaining links.
+ * @param g Graph
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param w Sorted candidates
+ * @param n Number of candidates
+ * @param st State of search
+ * @return number of selected links
+ */
+static int select_links(hgraph_t *g, hstring_t *s,
+                        double (*measure) (hstring_t, hstring_t),
+                        hlink_t *w, long n, search_t *st)
+{
+    long i, np = 0;
+    int k, cnt = 0, good;
+
+    for (i = 0; i < n && cnt < g->links; i++) {
+        for (good = TRUE, k = 0; good && k < cnt; k++)
+            good = !(graph_dist(g, s, measure, g->base + w[i].id,
+                                g->base + st->sel[k].id, st) < w[i].dist);
+        if (good)
+            st->sel[cnt++] = w[i];
+        else
+            st->pruned[np++] = i;
+    }
+
+    for (i = 0; i < np && cnt < g->links; i++)
+        st->sel[cnt++] = w[st->pruned[i]];
+
+    return cnt;
+}
+
+/**
+ * Add a link to a node. If the node has no free links, the farthest link
+ * is replaced.
+ * @param g Graph
+ * @param i Index of node
+ * @param l Level
+ * @param e Link to add
+ */
+static void link_add(hgraph_t *g, long i, int l, hlink_t e)
+{
+    hnode_t *nd = g->nodes + i;
+    hlink_t *lk = nd->links[l];
+    int k, f = 0;
+
+    NODE_LOCK(g, i);
+    if (nd->num[l] < level_links(g, l)) {
+        lk[nd->num[l]++] = e;
+    } else {
+        for (k = 1; k < nd->num[l]; k++)
+            if (link_closer(lk[f], lk[k]))
+                f = k;
+        if (link_closer(e, lk[f]))
+            lk[f] = e;
+    }
+    NODE_UNLOCK(g, i);
+}
+
+/**
+ * Insert a node into the graph
+ * @param g Graph
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param i Index of node
+ * @param st State of search
+ */
+static void graph_insert(hgraph_t *g, hstring_t *s,
+                         double (*measure) (hstring_t, hstring_t),
+                         long i, search_t *st)
+{
+    hnode_t *nd = g->nodes + i;
+    long q = g->base + i;
+    hlink_t e;
+    int l, top, n, k;
+
+    ENTRY_LOCK(g);
+    e.id = g->entry;
+    top = g->top;
+    ENTRY_UNLOCK(g);
+
+    e.dist = graph_dist(g, s, measure, g->base + e.id, q, st);
+    for (l = top; l > nd->level; l--)
+        e = search_greedy(g, s, measure, q, e, l, st);
+
+    for (l = MIN(top, nd->level); l >= 0; l--) {
+        search_start(g, st, e, i);
+        search_level(g, s, measure, q, l, g->effort, st);
+        qsort(st->res, st->nres, sizeof(hlink_t), link_cmp);
+        e = st->res[0];
+
+        n = select_links(g, s, measure, st->res, st->nres, st);
+        NODE_LOCK(g, i);
+        memcpy(nd->links[l], st->sel, n * sizeof(hlink_t));
+        nd->num[l] = n;
+        NODE_UNLOCK(g, i);
+
+        for (k = 0; k < n; k++) {
+            hlink_t r = { i, st->sel[k].dist };
+            link_add(g, st->sel[k].id, l, r);
+        }
+    }
+
+    ENTRY_LOCK(g);
+    if (nd->level > g->top) {
+        g->top = nd->level;
+        g->entry = i;
+    }
+    ENTRY_UNLOCK(g);
+}
+
+/**
+ * Build a graph over the strings of the column range of a matrix. The
+ * strings are inserted in parallel using the configured threads.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param links Maximum number of links per level
+ * @param effort Number of candidates during building
+ * @return graph or NULL on error
+ */
+hgraph_t *hgraph_build(hmatrix_t *m, hstring_t *s,
+                       double (*measure) (hstring_t, hstring_t),
+                       int links, int effort)
+{
+    long n = RANGE_LENGTH(m->col), done = 0, i;
+    int l, threads = 1;
+    double ml = 1.0 / log(MAX(links, 2));
+    search_t *st;
+    hgraph_t *g;
+
+    assert(m && s && links > 0);
+
+    if (n > INT32_MAX) {
+        error("Too many strings for graph");
+        return NULL;
+    }
+
+    g = calloc(1, sizeof(hgraph_t));
+    if (!g || !(g->nodes = calloc(MAX(n, 1), sizeof(hnode_t)))) {
+        error("Could not allocate graph");
+        free(g);
+        return NULL;
+    }
+
+    g->num = n;
+    g->base = m->col.start;
+    g->entry = -1;
+    g->links = links;
+    g->effort = MAX(effort, links);
+    g->descending = m->descending;
+
+    for (i = 0; i < n; i++) {
+        hnode_t *nd = g->nodes + i;
+        nd->level = node_level(i, ml);
+        nd->num = calloc(nd->level + 1, sizeof(int));
+        nd->links = calloc(nd->level + 1, sizeof(hlink_t *));
+        for (l = 0; nd->links && l <= nd->level; l++)
+            if (!(nd->links[l] = malloc(level_links(g, l) * sizeof(hlink_t))))
+                break;
+        if (!nd->num || !nd->links || l <= nd->level) {
+            error("Could not allocate nodes of graph");
+            g->num = i + 1;
+            hgraph_destroy(g);
+            return NULL;
+        }
+    }
+
+#ifdef HAVE_OPENMP
+    threads = omp_get_max_threads();
+    g->locks = malloc(MAX(n, 1) * sizeof(omp_lock_t));
+    if (!g->locks) {
+        error("Could not allocate locks of graph");
+        hgraph_destroy(g);
+        return NULL;
+    }
+    for (i = 0; i < n; i++)
+        omp_init_lock(g->locks + i);
+    omp_init_lock(&g->lock);
+#endif
+
+    if (n == 0)
+        return g;
+
+    st = search_alloc(g, g->effort, threads);
+    if (!st) {
+        hgraph_destroy(g);
+        return NULL;
+    }
+
+    /* The first node is the initial entry point */
+    g->entry = 0;
+    g->top = g->nodes[0].level;
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+    for (i = 1; i < n; i++) {
+#ifdef HAVE_OPENMP
+        search_t *t = st + omp_get_thread_num();
+#else
+        search_t *t = st;
+#endif
+        graph_insert(g, s, measure, i, t);
+
+        if (verbose) {
+#ifdef HAVE_OPENMP
+#pragma omp critical (hgraph_progress)
+#endif
+            if (++done % 100 == 0)
+                prog_bar(0, n, done);
+        }
+    }
+
+    if (verbose)
+        prog_bar(0, n, n);
+
+    for (l = 0; l < threads; l++)
+        g->calcs += st[l].calcs;
+    search_free(st, threads);
+    return g;
+}
+
+/**
+ * Compare two links by ascending node index
+ * @param x First link
+ * @param y Second link
+ * @return comparison result
+ */
+static int link_cmp_id(const void *x, const void *y)
+{
+    int32_t a = ((hlink_t *) x)->id, b = ((hlink_t *) y)->id;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Search the graph for the nearest neighbors of each string of the row
+ * range of a matrix. The neighbors are stored in the sparse matrix.
+ * @param g Graph
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param effort Number of candidates during searching
+ * @return number of computed comparisons or -1 on error
+ */
+long hgraph_query(hgraph_t *g, hmatrix_t *m, hstring_t *s,
+                  double (*measure) (hstring_t, hstring_t), int effort)
+{
+    long rl = RANGE_LENGTH(m->row), k = m->knn, nnz = 0, done = 0, i, j;
+    long ef = MAX(effort, k + 1), calcs = 0;
+    int l, threads = 1;
+    hsparse_t *sp;
+    search_t *st;
+    hlink_t *res;
+    long *lens;
+
+    assert(g && m && s && k > 0);
+
+#ifdef HAVE_OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    st = search_alloc(g, ef, threads);
+    res = malloc(MAX(rl * k, 1) * sizeof(hlink_t));
+    lens = calloc(MAX(rl, 1), sizeof(long));
+    if (!st || !res || !lens) {
+        error("Could not allocate results of queries");
+        if (st)
+            search_free(st, threads);
+        free(res);
+        free(lens);
+        return -1;
+    }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16) private(j, l)
+#endif
+    for (i = 0; i < rl; i++) {
+#ifdef HAVE_OPENMP
+        search_t *t = st + omp_get_thread_num();
+#else
+        search_t *t = st;
+#endif
+        long q = m->row.start + i;
+        hlink_t e, *r = res + i * k;
+
+        if (g->entry < 0)
+            continue;
+
+        e.id = g->entry;
+        e.dist = graph_dist(g, s, measure, g->base + e.id, q, t);
+        for (l = g->top; l > 0; l--)
+            e = search_greedy(g, s, measure, q, e, l, t);
+
+        search_start(g, t, e, -1);
+        search_level(g, s, measure, q, 0, ef, t);
+        qsort(t->res, t->nres, sizeof(hlink_t), link_cmp);
+
+        /* Strings are not paired with themselves */
+        for (j = 0; j < t->nres && lens[i] < k; j++) {
+            if (g->base + t->res[j].id == q || isinf(t->res[j].dist))
+                continue;
+            r[lens[i]++] = t->res[j];
+        }
+        qsort(r, lens[i], sizeof(hlink_t), link_cmp_id);
+
+        if (verbose) {
+#ifdef HAVE_OPENMP
+#pragma omp critical (hgraph_progress)
+#endif
+            if (++done % 100 == 0)
+                prog_bar(0, rl, done);
+        }
+    }
+
+    if (verbose)
+        prog_bar(0, rl, rl);
+
+    for (l = 0; l < threads; l++)
+        calcs += st[l].calcs;
+    search_free(st, threads);
+
+    /* Assemble sparse matrix */
+    for (i = 0; i < rl; i++)
+        nnz += lens[i];
+
+    sp = hmatrix_sparse_alloc(rl, nnz);
+    if (!sp) {
+        calcs = -1;
+        goto out;
+    }
+
+    for (nnz = 0, i = 0; i < rl; i++) {
+        for (j = 0; j < lens[i]; j++, nnz++) {
+            hlink_t e = res[i * k + j];
+            sp->cols[nnz] = g->base + e.id;
+            sp->vals[nnz] = g->descending ? -e.dist : e.dist;
+        }
+        sp->ptr[i + 1] = nnz;
+    }
+    sp->nnz = nnz;
+    m->sparse = sp;
+    m->size = nnz;
+
+  out:
+    free(res);
+    free(lens);
+    return calcs;
+}
+
+/**
+ * Estimate the recall of approximate nearest neighbors. The neighbors
+ * of a sample of rows are computed exactly and compared with those
+ * stored in the sparse matrix.
+ * @param m Matrix object with approximate neighbors
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param num Number of sampled rows
+ * @return fraction of exact neighbors found
+ */
+double hgraph_recall(hmatrix_t *m, hstring_t *s,
+                     double (*measure) (hstring_t, hstring_t), long num)
+{
+    long rl = RANGE_LENGTH(m->row), k = m->knn, found = 0, total = 0, i;
+
+    assert(m && s && m->sparse && k > 0);
+
+    num = MIN(num, rl);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:found,total)
+#endif
+    for (i = 0; i < num; i++) {
+        long r = i * rl / num, q = m->row.start + r, n = 0, a, b;
+        hsparse_t *sp = m->sparse;
+        hlink_t *h = malloc(k * sizeof(hlink_t));
+
+        if (!h) {
+            error("Could not allocate neighbors");
+            continue;
+        }
+
+        /* Exact neighbors (heap with farthest on top) */
+        for (long c = m->col.start; c < m->col.end; c++) {
+            hlink_t e;
+            float v = measure(s[c], s[q]);
+            if (c == q || isnan(v))
+                continue;
+            e.id = c;
+            e.dist = m->descending ? -v : v;
+            if (n < k)
+                heap_push(h, &n, e, TRUE);
+            else if (link_closer(e, h[0])) {
+                heap_pop(h, &n, TRUE);
+                heap_push(h, &n, e, TRUE);
+            }
+        }
+        qsort(h, n, sizeof(hlink_t), link_cmp_id);
+
+        /* Intersect with approximate neighbors */
+        for (a = sp->ptr[r], b = 0; a < sp->ptr[r + 1] && b < n;) {
+            if (sp->cols[a] < h[b].id)
+                a++;
+            else if (sp->cols[a] > h[b].id)
+                b++;
+            else
+                a++, b++, found++;
+        }
+        total += n;
+        free(h);
+    }
+
+    return total > 0 ? (double) found / total : 1.0;
+}
+
+/**
+ * Destroy a graph
+ * @param g Graph
+ */
+void hgraph_destroy(hgraph_t *g)
+{
+    if (!g)
+        return;
+
+    for (long i = 0; i < g->num; i++) {
+        hnode_t *nd = g->nodes + i;
+        for (int l = 0; nd->links && l <= nd->level; l++)
+            free(nd->links[l]);
+        free(nd->links);
+        free(nd->num);
+    }
+
+#ifdef HAVE_OPENMP
+    if (g->locks) {
+        for (long i = 0; i < g->num; i++)
+            omp_destroy_lock(g->locks + i);
+        omp_destroy_lock(&g->lock);
+        free(g->locks);
+    }
+#endif
+
+    free(g->nodes);
+    free(g);
+}
+
+/** @} */
@@ -0,0 +1,67 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef HGRAPH_H
+#define HGRAPH_H
+
+#include "hmatrix.h"
+
+/* Maximum number of levels */
+#define GRAPH_LEVELS    16
+
+/**
+ * Link between two nodes of the graph
+ */
+typedef struct
+{
+    int32_t id;         /**< Target node (relative to column range) */
+    float dist;         /**< Distance to target node */
+} hlink_t;
+
+/**
+ * Node of the graph with links on each of its levels
+ */
+typedef struct
+{
+    int level;          /**< Highest level of node */
+    int *num;           /**< Number of links on each level */
+    hlink_t **links;    /**< Links on each level */
+} hnode_t;
+
+/**
+ * Navigable small-world graph over the strings of the column range
+ */
+typedef struct
+{
+    hnode_t *nodes;     /**< Nodes of graph */
+    long num;           /**< Number of nodes */
+    long base;          /**< Start of column range */
+    long entry;         /**< Entry node or -1 */
+    int top;            /**< Highest level of graph */
+    int links;          /**< Maximum number of links per level */
+    int effort;         /**< Number of candidates during building */
+    int descending;     /**< Larger values are more similar */
+    long calcs;         /**< Comparisons computed for building */
+#ifdef HAVE_OPENMP
+    omp_lock_t *locks;  /**< Locks of nodes */
+    omp_lock_t lock;    /**< Lock of entry node */
+#endif
+} hgraph_t;
+
+hgraph_t *hgraph_build(hmatrix_t *, hstring_t *,
+                       double (*measure) (hstring_t, hstring_t), int, int);
+long hgraph_query(hgraph_t *, hmatrix_t *, hstring_t *,
+                  double (*measure) (hstring_t, hstring_t), int);
+double hgraph_recall(hmatrix_t *, hstring_t *,
+                     double (*measure) (hstring_t, hstring_t), long);
+void hgraph_destroy(hgraph_t *);
+
+#endif /* HGRAPH_H */
@@ -0,0 +1,594 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+/**
+ * @defgroup index Metric index
+ * Functions for indexing strings with a vantage-point tree (Yianilos,
+ * 1993). The tree is built over the strings of the column range and
+ * answers range and nearest-neighbor queries for the strings of the row
+ * range. Subtrees are pruned using the triangle inequality, such that
+ * the results equal those of a full computation if the similarity
+ * measure is a metric. The tree can be stored in a file and reused for
+ * further queries against the same strings.
+ * @author Konrad Rieck (konrad@mlsec.org)
+ * @{
+ */
+
+#include "config.h"
+#include "common.h"
+#include "util.h"
+#include "murmur.h"
+#include "hindex.h"
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+/* External variables */
+extern int verbose;
+extern config_t cfg;
+
+/* Similarity measures that are metrics */
+static char *metrics[] = {
+    "dist_levenshtein", "dist_edit", "dist_damerau", "dist_hamming",
+    "dist_lee", NULL
+};
+
+/**
+ * String with distance to a vantage point used during building
+ */
+typedef struct
+{
+    long id;            /**< Index of string (relative) */
+    float dist;         /**< Distance to vantage point */
+} item_t;
+
+/**
+ * Result of a query
+ */
+typedef struct
+{
+    long col;           /**< Column index */
+    float val;          /**< Distance */
+} hit_t;
+
+/**
+ * State of a query
+ */
+typedef struct
+{
+    hindex_t *x;        /**< Index */
+    hstring_t *s;       /**< Array of string objects */
+    double (*measure) (hstring_t, hstring_t);   /**< Distance */
+    long row;           /**< Row of query */
+    double radius;      /**< Radius of range query */
+    long k;             /**< Number of neighbors (or 0) */
+    hit_t *hits;        /**< Results (heap for neighbors) */
+    long num;           /**< Number of results */
+    long size;          /**< Capacity of results */
+    long calcs;         /**< Computed distances */
+} query_t;
+
+/**
+ * Draw a random number (xorshift64*)
+ * @param x State of generator
+ * @return random number
+ */
+static inline uint64_t next_rand(uint64_t *x)
+{
+    *x ^= *x >> 12;
+    *x ^= *x << 25;
+    *x ^= *x >> 27;
+    return (*x * 0x2545F4914F6CDD1DULL) >> 11;
+}
+
+/**
+ * Compare two items by ascending distance. NaN values are sorted last.
+ * @param x First item
+ * @param y Second item
+ * @return comparison result
+ */
+static int item_cmp(const void *x, const void *y)
+{
+    float a = ((item_t *) x)->dist, b = ((item_t *) y)->dist;
+
+    if (isnan(a) || isnan(b))
+        return isnan(a) - isnan(b);
+    return (a > b) - (a < b);
+}
+
+/**
+ * Check whether a result is closer than another. Ties are broken by the
+ * column index as for the full computation of nearest neighbors.
+ * @param a First result
+ * @param b Second result
+ * @return true if a is closer than b
+ */
+static inline int hit_better(hit_t a, hit_t b)
+{
+    if (a.val != b.val)
+        return a.val < b.val;
+    return a.col < b.col;
+}
+
+/**
+ * Compare two results by ascending column indices
+ * @param x First result
+ * @param y Second result
+ * @return comparison result
+ */
+static int hit_cmp_col(const void *x, const void *y)
+{
+    long a = ((hit_t *) x)->col, b = ((hit_t *) y)->col;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Compute a fingerprint of the strings of the column range
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @return fingerprint
+ */
+static uint64_t index_fingerprint(hmatrix_t *m, hstring_t *s)
+{
+    uint64_t h = RANGE_LENGTH(m->col);
+
+    for (long i = m->col.start; i < m->col.end; i++) {
+        h = MurmurHash64B(&s[i].len, sizeof(s[i].len), h);
+        if (s[i].len > 0)
+            h ^= hstring_hash1(s[i]);
+    }
+
+    return h;
+}
+
+/**
+ * Build a subtree of the index. A random vantage point is selected and
+ * the remaining strings are split at the median of their distances.
+ * @param x Index
+ * @param s Array of string objects
+ * @param measure Distance
+ * @param it Items of subtree
+ * @param n Number of items
+ * @param seed State of random number generator
+ * @return node of subtree or -1 if empty
+ */
+static long build_node(hindex_t *x, hstring_t *s,
+                       double (*measure) (hstring_t, hstring_t),
+                       item_t *it, long n, uint64_t *seed)
+{
+    long k, h, v;
+    item_t t;
+
+    if (n == 0)
+        return -1;
+
+    /* Move random vantage point to the front */
+    k = next_rand(seed) % n;
+    t = it[0], it[0] = it[k], it[k] = t;
+
+    v = x->num++;
+    x->nodes[v].id = it[0].id;
+
+    hstring_t p = s[x->base + it[0].id];
+#ifdef HAVE_OPENMP
+#pragma omp parallel for if (n > 256)
+#endif
+    for (k = 1; k < n; k++)
+        it[k].dist = measure(p, s[x->base + it[k].id]);
+    x->calcs += n - 1;
+
+    qsort(it + 1, n - 1, sizeof(item_t), item_cmp);
+
+    /* Split at median */
+    h = (n - 1) / 2;
+    x->nodes[v].lmin = h > 0 ? it[1].dist : NAN;
+    x->nodes[v].lmax = h > 0 ? it[h].dist : NAN;
+    x->nodes[v].rmin = n - 1 > h ? it[h + 1].dist : NAN;
+    x->nodes[v].rmax = n - 1 > h ? it[n - 1].dist : NAN;
+
+    x->nodes[v].left = build_node(x, s, measure, it + 1, h, seed);
+    x->nodes[v].right = build_node(x, s, measure, it + 1 + h, n - 1 - h,
+                                   seed);
+    return v;
+}
+
+/**
+ * Build an index over the strings of the column range of a matrix.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param measure Distance
+ * @return index or NULL on error
+ */
+hindex_t *hindex_build(hmatrix_t *m, hstring_t *s,
+                       double (*measure) (hstring_t, hstring_t))
+{
+    long n = RANGE_LENGTH(m->col);
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    hindex_t *x;
+    item_t *it;
+
+    assert(m && s);
+
+    x = calloc(1, sizeof(hindex_t));
+    it = malloc(MAX(n, 1) * sizeof(item_t));
+    if (!x || !it || !(x->nodes = malloc(MAX(n, 1) * sizeof(vpnode_t)))) {
+        error("Could not allocate index");
+        free(it);
+        free(x);
+        return NULL;
+    }
+
+    for (long i = 0; i < n; i++)
+        it[i].id = i;
+
+    x->base = m->col.start;
+    x->input = index_fingerprint(m, s);
+    build_node(x, s, measure, it, n, &seed);
+
+    free(it);
+    return x;
+}
+
+/**
+ * Add a result to a range query
+ * @param q Query
+ * @param h Result
+ */
+static void range_add(query_t *q, hit_t h)
+{
+    hit_t *p;
+
+    if (q->num == q->size) {
+        p = realloc(q->hits, MAX(2 * q->size, 16) * sizeof(hit_t));
+        if (!p) {
+            error("Could not allocate results of query");
+            return;
+        }
+        q->hits = p;
+        q->size = MAX(2 * q->size, 16);
+    }
+
+    q->hits[q->num++] = h;
+}
+
+/**
+ * Add a result to a nearest-neighbor query. The results are kept in a
+ * heap with the farthest neighbor on top.
+ * @param q Query
+ * @param e Result
+ */
+static void knn_add(query_t *q, hit_t e)
+{
+    hit_t *h = q->hits;
+    long i, j;
+
+    if (q->num < q->k) {
+        for (i = q->num++; i > 0 && hit_better(h[(i - 1) / 2], e);
+             i = (i - 1) / 2)
+            h[i] = h[(i - 1) / 2];
+        h[i] = e;
+        return;
+    }
+
+    if (!hit_better(e, h[0]))
+        return;
+
+    for (i = 0; (j = 2 * i + 1) < q->k; i = j) {
+        if (j + 1 < q->k && hit_better(h[j], h[j + 1]))
+            j++;
+        if (!hit_better(e, h[j]))
+            break;
+        h[i] = h[j];
+    }
+    h[i] = e;
+}
+
+/**
+ * Return the current radius of a query. For nearest neighbors, the
+ * radius shrinks to the distance of the farthest neighbor found.
+ * @param q Query
+ * @return radius
+ */
+static inline double query_radius(query_t *q)
+{
+    if (q->k == 0)
+        return q->radius;
+    return q->num < q->k ? INFINITY : q->hits[0].val;
+}
+
+/**
+ * Check whether a subtree can be pruned. By the triangle inequality,
+ * the strings of the subtree are at least max(min - d, d - max) away
+ * from the query. NaN values never prune. Bounded distances are infinite
+ * beyond their bound and thus do not prune either, except for an
+ * infinite maximum that only weakens the bound.
+ * @param d Distance of query to vantage point
+ * @param min Minimum distance of subtree
+ * @param max Maximum distance of subtree
+ * @param r Radius of query
+ * @return true if pruned
+ */
+static inline int prune(float d, float min, float max, double r)
+{
+    if (isinf(d) || isinf(min))
+        return FALSE;
+    return fmax(min - d, d - max) > r;
+}
+
+/**
+ * Search a subtree of the index
+ * @param q Query
+ * @param v Node of subtree
+ */
+static void query_node(query_t *q, long v)
+{
+    vpnode_t *nd;
+    int near;
+    hit_t h;
+    long c;
+
+    if (v < 0)
+        return;
+
+    nd = q->x->nodes + v;
+    c = q->x->base + nd->id;
+    h.col = c;
+    h.val = q->measure(q->s[c], q->s[q->row]);
+    q->calcs++;
+
+    /* Strings are not paired with themselves */
+    if (c != q->row && !isnan(h.val)) {
+        if (q->k > 0)
+            knn_add(q, h);
+        else if (h.val <= q->radius)
+            range_add(q, h);
+    }
+
+    /* Visit the closer subtree first to shrink the radius early */
+    near = !(h.val > 0.5 * (nd->lmax + nd->rmin));
+    for (int k = 0; k < 2; k++) {
+        if ((k == 0) == near) {
+            if (!prune(h.val, nd->lmin, nd->lmax, query_radius(q)))
+                query_node(q, nd->left);
+        } else {
+            if (!prune(h.val, nd->rmin, nd->rmax, query_radius(q)))
+                query_node(q, nd->right);
+        }
+    }
+}
+
+/**
+ * Query the index for each string of the row range of a matrix. Either
+ * the k nearest neighbors or all strings within the threshold are
+ * stored in the sparse matrix.
+ * @param x Index
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param measure Distance
+ * @return number of computed distances or -1 on error
+ */
+long hindex_query(hindex_t *x, hmatrix_t *m, hstring_t *s,
+                  double (*measure) (hstring_t, hstring_t))
+{
+    long rl = RANGE_LENGTH(m->row), nnz = 0, calcs = 0, done = 0, i, j;
+    hsparse_t *sp;
+    hit_t **res;
+    long *lens;
+
+    assert(x && m && s && (m->knn > 0 || !isnan(m->threshold)));
+
+    res = calloc(rl, sizeof(hit_t *));
+    lens = calloc(rl, sizeof(long));
+    if (!res || !lens) {
+        error("Could not allocate results of queries");
+        free(res);
+        free(lens);
+        return -1;
+    }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16) reduction(+:calcs)
+#endif
+    for (i = 0; i < rl; i++) {
+        query_t q = { x, s, measure, m->row.start + i, m->threshold,
+            m->knn, NULL, 0, 0, 0
+        };
+
+        if (q.k > 0) {
+            q.hits = malloc(q.k * sizeof(hit_t));
+            if (!q.hits) {
+                error("Could not allocate results of query");
+                continue;
+            }
+        }
+
+        query_node(&q, x->num > 0 ? 0 : -1);
+        qsort(q.hits, q.num, sizeof(hit_t), hit_cmp_col);
+        res[i] = q.hits;
+        lens[i] = q.num;
+        calcs += q.calcs;
+
+        if (verbose) {
+#ifdef HAVE_OPENMP
+#pragma omp critical (hindex_progress)
+#endif
+            if (++done % 100 == 0)
+                prog_bar(0, rl, done);
+        }
+    }
+
+    if (verbose)
+        prog_bar(0, rl, rl);
+
+    /* Assemble sparse matrix */
+    for (i = 0; i < rl; i++)
+        nnz += lens[i];
+
+    sp = hmatrix_sparse_alloc(rl, nnz);
+    if (!sp) {
+        calcs = -1;
+        goto out;
+    }
+
+    for (nnz = 0, i = 0; i < rl; i++) {
+        for (j = 0; j < lens[i]; j++, nnz++) {
+            sp->cols[nnz] = res[i][j].col;
+            sp->vals[nnz] = res[i][j].val;
+        }
+        sp->ptr[i + 1] = nnz;
+    }
+    sp->nnz = nnz;
+    m->sparse = sp;
+    m->size = nnz;
+
+  out:
+    for (i = 0; i < rl; i++)
+        free(res[i]);
+    free(res);
+    free(lens);
+    return calcs;
+}
+
+/**
+ * Load an index from a file. The index must match the configuration
+ * and the strings of the column range.
+ * @param file Name of file
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param config Fingerprint of configuration
+ * @return index or NULL if the file does not exist
+ */
+hindex_t *hindex_load(char *file, hmatrix_t *m, hstring_t *s,
+                      uint64_t config)
+{
+    index_header_t h;
+    hindex_t *x;
+    FILE *f;
+    long i, n = RANGE_LENGTH(m->col);
+
+    f = fopen(file, "r");
+    if (!f)
+        return NULL;
+
+    if (fread(&h, sizeof(h), 1, f) != 1 ||
+        memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) ||
+        h.version != INDEX_VERSION)
+        fatal("Could not read index file '%s'", file);
+
+    if (h.config != config || h.num != n ||
+        h.input != index_fingerprint(m, s))
+        fatal("Index file '%s' does not match configuration", file);
+
+    x = calloc(1, sizeof(hindex_t));
+    if (!x || !(x->nodes = malloc(MAX(n, 1) * sizeof(vpnode_t)))) {
+        error("Could not allocate index");
+        free(x);
+        fclose(f);
+        return NULL;
+    }
+
+    if (fread(x->nodes, sizeof(vpnode_t), n, f) != (size_t) n)
+        fatal("Could not read index file '%s'", file);
+    fclose(f);
+
+    for (i = 0; i < n; i++)
+        if (x->nodes[i].id < 0 || x->nodes[i].id >= n ||
+            x->nodes[i].left < -1 || x->nodes[i].left >= n ||
+            x->nodes[i].right < -1 || x->nodes[i].right >= n)
+            fatal("Index file '%s' is corrupted", file);
+
+    x->num = n;
+    x->base = m->col.start;
+    x->input = h.input;
+    return x;
+}
+
+/**
+ * Save an index to a file
+ * @param x Index
+ * @param file Name of file
+ * @param config Fingerprint of configuration
+ * @return true on success, false otherwise
+ */
+int hindex_save(hindex_t *x, char *file, uint64_t config)
+{
+    index_header_t h;
+    FILE *f;
+    int r;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+    h.version = INDEX_VERSION;
+    h.num = x->num;
+    h.config = config;
+    h.input = x->input;
+
+    f = fopen(file, "w");
+    if (!f) {
+        error("Could not open index file '%s'", file);
+        return FALSE;
+    }
+
+    r = fwrite(&h, sizeof(h), 1, f) == 1 &&
+        fwrite(x->nodes, sizeof(vpnode_t), x->num, f) == (size_t) x->num;
+    if (fclose(f) != 0 || !r) {
+        error("Could not write index file '%s'", file);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Check whether a similarity measure is a metric. Different costs for
+ * insertion and deletion yield asymmetric distances.
+ * @param name Name of measure
+ * @return true if metric, false otherwise
+ */
+int hindex_metric(const char *name)
+{
+    double ins = 1.0, del = 1.0;
+    char key[256];
+    int i;
+
+    for (i = 0; metrics[i]; i++)
+        if (!strcmp(name, metrics[i]))
+            break;
+    if (!metrics[i])
+        return FALSE;
+
+    /* Alias of the Levenshtein distance */
+    if (!strcmp(name, "dist_edit"))
+        name = "dist_levenshtein";
+
+    snprintf(key, sizeof(key), "measures.%s.cost_ins", name);
+    config_lookup_float(&cfg, key, &ins);
+    snprintf(key, sizeof(key), "measures.%s.cost_del", name);
+    config_lookup_float(&cfg, key, &del);
+
+    return ins == del;
+}
+
+/**
+ * Destroy an index
+ * @param x Index
+ */
+void hindex_destroy(hindex_t *x)
+{
+    if (!x)
+        return;
+
+    free(x->nodes);
+    free(x);
+}
+
+/** @} */
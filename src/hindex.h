@@ -0,0 +1,71 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef HINDEX_H
+#define HINDEX_H
+
+#include "hmatrix.h"
+
+/* Header of index files */
+#define INDEX_MAGIC     "HARRYIDX"
+#define INDEX_VERSION   1
+
+/**
+ * Header of an index file. The header is followed by the nodes.
+ */
+typedef struct
+{
+    char magic[8];      /**< Magic string */
+    uint32_t version;   /**< Version of file format */
+    uint32_t reserved;  /**< Reserved (zero) */
+    int64_t num;        /**< Number of nodes */
+    uint64_t config;    /**< Fingerprint of configuration */
+    uint64_t input;     /**< Fingerprint of indexed strings */
+} index_header_t;
+
+/**
+ * Node of a vantage-point tree. The strings of the left subtree are
+ * closer to the vantage point than those of the right subtree. The
+ * distances of each subtree to the vantage point are bounded.
+ */
+typedef struct
+{
+    int64_t id;         /**< Vantage point (relative to column range) */
+    int64_t left;       /**< Left subtree or -1 */
+    int64_t right;      /**< Right subtree or -1 */
+    float lmin;         /**< Minimum distance in left subtree */
+    float lmax;         /**< Maximum distance in left subtree */
+    float rmin;         /**< Minimum distance in right subtree */
+    float rmax;         /**< Maximum distance in right subtree */
+} vpnode_t;
+
+/**
+ * Metric index over the strings of the column range
+ */
+typedef struct
+{
+    vpnode_t *nodes;    /**< Nodes of tree (root first) */
+    long num;           /**< Number of nodes */
+    long base;          /**< Start of column range */
+    uint64_t input;     /**< Fingerprint of indexed strings */
+    long calcs;         /**< Distances computed for building */
+} hindex_t;
+
+hindex_t *hindex_build(hmatrix_t *, hstring_t *,
+                       double (*measure) (hstring_t, hstring_t));
+hindex_t *hindex_load(char *, hmatrix_t *, hstring_t *, uint64_t);
+int hindex_save(hindex_t *, char *, uint64_t);
+long hindex_query(hindex_t *, hmatrix_t *, hstring_t *,
+                  double (*measure) (hstring_t, hstring_t));
+int hindex_metric(const char *);
+void hindex_destroy(hindex_t *);
+
+#endif /* HINDEX_H */
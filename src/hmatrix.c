@@ -27,15 +27,100 @@
 extern int verbose;
 extern int log_line;
 
+/* Default size of L2 cache if it cannot be determined */
+#define L2_CACHE_SIZE   (256 * 1024)
+/* Bounds for the side length of tiles */
+#define TILE_MIN        16
+#define TILE_MAX        1024
+/* Maximum number of tiles in a schedule */
+#define TILE_COUNT      (1 << 20)
+/* Number of cells of a row compared at once */
+#define BATCH_SIZE      64
+
 /**
- * Initialize a matrix for similarity values
- * @param s Array of string objects
+ * String index ordered by length
+ */
+typedef struct
+{
+    long len;                   /**< Length of string */
+    long idx;                   /**< Index of string */
+} order_t;
+
+/**
+ * Tile of the matrix in a schedule
+ */
+typedef struct
+{
+    long r;                     /**< First row position of tile */
+    long c;                     /**< First column position of tile */
+    double cost;                /**< Estimated cost of tile */
+} tile_t;
+
+/**
+ * Schedule for computing the matrix. Rows and columns are ordered by
+ * decreasing length of the strings and the tiles by decreasing cost.
+ */
+typedef struct
+{
+    long *rows;                 /**< Row indices ordered by length */
+    long *cols;                 /**< Column indices ordered by length */
+    long nr;                    /**< Number of rows */
+    long nc;                    /**< Number of columns */
+    long t;                     /**< Side length of tiles */
+    tile_t *tiles;              /**< Tiles ordered by cost */
+    long num;                   /**< Number of tiles */
+} sched_t;
+
+/**
+ * String index with hash value
+ */
+typedef struct
+{
+    uint64_t hash;              /**< Hash of string */
+    long idx;                   /**< Index of string */
+} dedup_t;
+
+/**
+ * Entry of a sparse row used during computation
+ */
+typedef struct
+{
+    long col;                   /**< Column index */
+    float val;                  /**< Similarity value */
+} entry_t;
+
+/**
+ * Pair of strings used during computation
+ */
+typedef struct
+{
+    long row;                   /**< Row index */
+    entry_t e;                  /**< Column index and similarity value */
+} pair_t;
+
+/**
+ * Thread-local buffer of sparse similarity values. Either bounded heaps
+ * of nearest neighbors or a list of pairs are used.
+ */
+typedef struct
+{
+    entry_t *heaps;             /**< Heaps of k entries for each row */
+    long *lens;                 /**< Number of entries in each heap */
+    pair_t *pairs;              /**< Pairs within threshold */
+    long num;                   /**< Number of pairs */
+    long size;                  /**< Capacity of pairs */
+} sbuf_t;
+
+/**
+ * Initialize a matrix for similarity values. If no strings are given,
+ * the labels are zero and the sources empty.
+ * @param s Array of string objects or NULL
  * @param n Number of string objects
  * @return Matrix object
  */
-hmatrix_t *hmatrix_init(hstring_t *s, int n)
+hmatrix_t *hmatrix_init(hstring_t *s, long n)
 {
-    assert(s && n >= 0);
+    assert(n >= 0);
 
     hmatrix_t *m = malloc(sizeof(hmatrix_t));
     if (!m) {
@@ -49,10 +134,23 @@ hmatrix_t *hmatrix_init(hstring_t *s, int n)
     m->col.end = n;
     m->row.start = 0;
     m->row.end = n;
+    m->block = m->row;
     m->triangular = TRUE;
+    m->dups = NULL;
+    m->cmap = NULL;
+    m->rmap = NULL;
+    m->fd = -1;
+    m->resume = FALSE;
+    m->sync = 0;
+    m->synced = 0;
+    m->sparse = NULL;
+    m->knn = 0;
+    m->threshold = NAN;
+    m->descending = FALSE;
 
     /* Initialized later */
     m->values = NULL;
+    m->type = VALUE_FLOAT;
     m->size = 0;
     m->calcs = 0;
 
@@ -65,7 +163,7 @@ hmatrix_t *hmatrix_init(hstring_t *s, int n)
     }
 
     /* Copy details from strings */
-    for (int i = 0; i < n; i++) {
+    for (long i = 0; s && i < n; i++) {
         m->labels[i] = s[i].label;
         m->srcs[i] = s[i].src ? strdup(s[i].src) : NULL;
     }
@@ -80,7 +178,7 @@ hmatrix_t *hmatrix_init(hstring_t *s, int n)
  * @param n Maximum size
  * @return Range object
  */
-static range_t parse_range(range_t r, char *s, int n)
+static range_t parse_range(range_t r, char *s, long n)
 {
     char *ptr, *end = NULL;
     long l;
@@ -107,7 +205,7 @@ static range_t parse_range(range_t r, char *s, int n)
     if (strlen(s) == 0)
         r.start = 0;
     else if (*end == '\0')
-        r.start = (int) l;
+        r.start = l;
     else
         error("Could not parse range '%s:...'.", s);
 
@@ -115,7 +213,7 @@ static range_t parse_range(range_t r, char *s, int n)
     if (strlen(ptr + 1) == 0)
         r.end = n;
     else if (*end == '\0')
-        r.end = (int) l;
+        r.end = l;
     else
         error("Could not parse range '...:%s'.", ptr + 1);
 
@@ -128,7 +226,8 @@ static range_t parse_range(range_t r, char *s, int n)
     /* Sanity checks */
     if (r.end < 0 || r.start < 0 || r.end > n || r.start > n - 1
         || r.start >= r.end) {
-        error("Invalid range '%s:%s'. Using default '0:%d'.", s, ptr + 1, n);
+        error("Invalid range '%s:%s'. Using default '0:%ld'.", s, ptr + 1,
+              n);
         r.start = 0;
         r.end = n;
     }
@@ -136,6 +235,132 @@ static range_t parse_range(range_t r, char *s, int n)
     return r;
 }
 
+/**
+ * Compare two strings by hash value and index
+ * @param x First string
+ * @param y Second string
+ * @return comparison result
+ */
+static int dedup_cmp(const void *x, const void *y)
+{
+    dedup_t a = *(dedup_t *) x, b = *(dedup_t *) y;
+
+    if (a.hash != b.hash)
+        return a.hash > b.hash ? 1 : -1;
+    return (a.idx > b.idx) - (a.idx < b.idx);
+}
+
+/**
+ * Check whether two strings are identical
+ * @param x First string
+ * @param y Second string
+ * @return true if the strings are identical
+ */
+static int string_equal(hstring_t x, hstring_t y)
+{
+    size_t len;
+
+    if (x.type != y.type || x.len != y.len)
+        return FALSE;
+
+    if (x.type == TYPE_TOKEN)
+        len = x.len * sizeof(sym_t);
+    else if (x.type == TYPE_BIT)
+        len = (x.len + 7) / 8;
+    else
+        len = x.len;
+
+    return len == 0 || !memcmp(x.str.c, y.str.c, len);
+}
+
+/**
+ * Detect duplicate strings in the ranges of the matrix. For each string
+ * the index of the previous identical string is stored. Only the first
+ * duplicate of each string within the columns and rows is compared and
+ * the other values are mapped to it (see hmatrix_get()).
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @return number of unique strings
+ */
+long hmatrix_dedup(hmatrix_t *m, hstring_t *s)
+{
+    long i, j, k, n = 0, u = 0;
+    dedup_t *d;
+
+    assert(m && s);
+
+    m->dups = malloc(m->num * sizeof(long));
+    d = malloc(m->num * sizeof(dedup_t));
+    if (!m->dups || !d) {
+        error("Could not allocate memory for duplicates");
+        free(m->dups);
+        free(d);
+        m->dups = NULL;
+        return 0;
+    }
+
+    /* Hash strings within ranges */
+    for (i = 0; i < m->num; i++) {
+        m->dups[i] = -1;
+        if ((i < m->col.start || i >= m->col.end) &&
+            (i < m->row.start || i >= m->row.end))
+            continue;
+        d[n].hash = s[i].len > 0 ? hstring_hash1(s[i]) : 0;
+        d[n++].idx = i;
+    }
+
+    qsort(d, n, sizeof(dedup_t), dedup_cmp);
+
+    /* Link each string to its previous duplicate */
+    for (i = 0; i < n; i++) {
+        for (j = i - 1; j >= 0 && d[j].hash == d[i].hash; j--) {
+            k = d[j].idx;
+            if (string_equal(s[k], s[d[i].idx])) {
+                m->dups[d[i].idx] = k;
+                break;
+            }
+        }
+        if (m->dups[d[i].idx] < 0)
+            u++;
+    }
+
+    free(d);
+    return u;
+}
+
+/**
+ * Map the strings of a range to their first duplicate within the range
+ * @param m Matrix object
+ * @param map Map of range (reallocated)
+ * @param r Range of strings
+ * @param u Return pointer to number of unique strings
+ * @return map of range
+ */
+static long *dedup_map(hmatrix_t *m, long *map, range_t r, long *u)
+{
+    long i, k, *rmap;
+
+    rmap = realloc(map, (r.end - r.start) * sizeof(long));
+    if (!rmap) {
+        error("Could not allocate memory for duplicates");
+        free(map);
+        return NULL;
+    }
+
+    /* Previous duplicates have been already mapped */
+    for (*u = 0, i = r.start; i < r.end; i++) {
+        k = m->dups[i];
+        if (k >= r.start) {
+            rmap[i - r.start] = rmap[k - r.start];
+        } else {
+            rmap[i - r.start] = i;
+            (*u)++;
+        }
+    }
+
+    return rmap;
+}
+
 /**
  * Infer the matrix' detailed specifications. This can be used
  * to accurately determine the number of \b unique values.
@@ -147,8 +372,8 @@ void hmatrix_inferspec(const hmatrix_t *m, hmatrixspec_t * spec)
 {
     assert(m != NULL && spec != NULL);
 
-    const int width = RANGE_LENGTH(m->col);
-    const int height = RANGE_LENGTH(m->row);
+    const long width = RANGE_LENGTH(m->col);
+    const long height = RANGE_LENGTH(m->row);
 
     const range_t c = m->col;
     const range_t r = m->row;
@@ -185,19 +410,19 @@ void hmatrix_inferspec(const hmatrix_t *m, hmatrixspec_t * spec)
 
     spec->n_top = width * spec->b_top;
     spec->n_mid = spec->a * spec->b_left +
-        (pow(spec->a, 2) + spec->a) / 2 + spec->a * spec->b_right;
+        (spec->a * spec->a + spec->a) / 2 + spec->a * spec->b_right;
     spec->n_bottom = width * spec->b_bottom;
     spec->n = spec->n_top + spec->n_mid + spec->n_bottom;
 }
 
-//#define USE_UNIFORM_SPLITTING
-
 /**
  * Enable splitting matrix
  * @param m Matrix object
+ * @param s Array of string objects
  * @param str Split string
+ * @param cx Complexity of similarity measure
  */
-void hmatrix_split(hmatrix_t *m, char *str)
+void hmatrix_split(hmatrix_t *m, hstring_t *s, char *str, int cx)
 {
     /* Empty string */
     if (strlen(str) == 0)
@@ -216,88 +441,147 @@ void hmatrix_split(hmatrix_t *m, char *str)
         return;
     }
 
-    hmatrix_split_ex(m, blocks, index);
+    hmatrix_split_ex(m, s, cx, blocks, index);
 }
 
-#ifdef USE_UNIFORM_SPLITTING
 /**
- * Determine the column slice 0:x that approximately holds
- * given the number of \b unique values.
- *
- * @param[in] N The approximate number of \b unique values.
- * @param[in] spec The detailed matrix specification.
- * @param[in] rows The range determining the contained number of rows.
+ * Estimate the cost of computing a block of rows. Each unique pair of
+ * the block (see hmatrix_inferspec()) costs one unit plus the length
+ * of the strings: len(x) + len(y) for linear and len(x) * len(y) for
+ * quadratic measures. Pairs mirrored within the block are subtracted.
+ * The sums are computed from prefix sums of the lengths in O(1).
+ * @param m Matrix object
+ * @param l1 Prefix sums of lengths
+ * @param l2 Prefix sums of squared lengths
+ * @param cx Complexity of similarity measure
+ * @param a Start of block (inclusive)
+ * @param b End of block (exclusive)
+ * @return estimated cost
  */
-int hmatrix_split_ridx(const unsigned int N, const hmatrixspec_t * spec,
-                       const range_t * rows)
+static double block_cost(hmatrix_t *m, double *l1, double *l2, int cx,
+                         long a, long b)
 {
-    assert(spec != NULL);
-
-    unsigned int n = N;
-    unsigned long width = (spec->b_left + spec->a + spec->b_right);
-
-    if (n <= 0) {
-        return rows->i;
-
-    } else if (n <= spec->n_top) {
-        return rows->i + rint(((double) n) / width);
+    hmatrix_t t = *m;
+    hmatrixspec_t spec;
+    double nb, nc, ni, sb, sc, si, qi, cost;
+    long is, ie;
+
+    /* Count unique pairs */
+    t.row.start = a;
+    t.row.end = b;
+    hmatrix_inferspec(&t, &spec);
+
+    /* Intersection of block and columns */
+    is = MAX(a, m->col.start);
+    ie = MIN(b, m->col.end);
+    if (ie < is)
+        ie = is;
+
+    nb = b - a;
+    nc = m->col.end - m->col.start;
+    ni = ie - is;
+    sb = l1[b] - l1[a];
+    sc = l1[m->col.end] - l1[m->col.start];
+    si = l1[ie] - l1[is];
+    qi = l2[ie] - l2[is];
+
+    if (cx >= 2)
+        cost = sb * sc - (si * si - qi) / 2;
+    else
+        cost = nc * sb + nb * sc - (ni > 0 ? (ni - 1) * si : 0);
 
-    } else if ((n -= spec->n_top) <= spec->n_mid) {
-        const long p = 1 + 2l * width;
-        const long q = 2 * n;
+    return spec.n + cost;
+}
 
-        const double y = sqrt(pow(p, 2) / 4.0 - q);
-        //const double x1 = p/2.0 +y;
-        const double x2 = p / 2.0 - y;
-        return rows->i + spec->b_top + rint(x2);
+/**
+ * Determine the end of a block of rows, such that its cost does not
+ * exceed a bound. Each block holds at least one row.
+ * @param m Matrix object
+ * @param l1 Prefix sums of lengths
+ * @param l2 Prefix sums of squared lengths
+ * @param cx Complexity of similarity measure
+ * @param a Start of block (inclusive)
+ * @param max Maximum end of block
+ * @param bound Bound for cost of block
+ * @return end of block (exclusive)
+ */
+static long block_end(hmatrix_t *m, double *l1, double *l2, int cx,
+                      long a, long max, double bound)
+{
+    long b = a + 1;
 
-    } else if ((n -= spec->n_mid) <= spec->n_bottom) {
-        return rows->i + spec->b_top + spec->a + rint(((double) n) / width);
+    while (b < max && block_cost(m, l1, l2, cx, a, b + 1) <= bound)
+        b++;
 
-    }
-    return rows->i + spec->b_top + spec->a + spec->b_bottom;
+    return b;
 }
-#endif
 
-void hmatrix_split_ex(hmatrix_t *m, const int blocks, const int index)
+/**
+ * Split the matrix into blocks of rows with balanced cost and restrict
+ * the row range to one of them. The largest cost of a block is
+ * minimized by a binary search over greedy partitions. The split is
+ * deterministic and the blocks cover all rows.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param cx Complexity of similarity measure
+ * @param blocks Number of blocks
+ * @param index Index of block
+ */
+void hmatrix_split_ex(hmatrix_t *m, hstring_t *s, int cx, const int blocks,
+                      const int index)
 {
-    const int width = RANGE_LENGTH(m->col);
-    const int height = RANGE_LENGTH(m->row);
+    const long height = RANGE_LENGTH(m->row);
+    double *l1, *l2, lo = 0, hi, mid;
+    long a, b, n;
+    int i;
 
     if (blocks <= 0 || blocks > height) {
         fatal("Invalid number of blocks (%d).", blocks);
         return;
     }
-#ifdef USE_UNIFORM_SPLITTING
-    hmatrixspec_t spec = { 0 };
-    hmatrix_inferspec(m, &spec);
-
-    const unsigned long blocksize = ceil(((double) spec.n) / blocks);
 
-    if (blocksize < width) {
-        const unsigned int max = floor(((double) spec.n) / width);
-        fatal("Block size too small. The maximum block size is %d.", max);
+    /* Prefix sums of lengths */
+    l1 = malloc((m->num + 1) * sizeof(double));
+    l2 = malloc((m->num + 1) * sizeof(double));
+    if (!l1 || !l2) {
+        fatal("Could not allocate memory for splitting matrix");
         return;
     }
 
-    /* Update range */
-    m->row.start = hmatrix_split_ridx(blocksize * index, &spec, &m->row);
-    m->row.end = hmatrix_split_ridx(blocksize * (index + 1), &spec, &m->row);
+    l1[0] = l2[0] = 0;
+    for (a = 0; a < m->num; a++) {
+        l1[a + 1] = l1[a] + s[a].len;
+        l2[a + 1] = l2[a] + (double) s[a].len * s[a].len;
+    }
 
-#else
-    UNUSED(width);
-    const int block_height = ceil(height / (float) blocks);
+    /* Binary search for smallest bound with at most the given blocks */
+    hi = block_cost(m, l1, l2, cx, m->row.start, m->row.end);
+    for (i = 0; i < 100 && hi - lo > 1e-9 * hi; i++) {
+        mid = (lo + hi) / 2;
+        for (n = 0, a = m->row.start; a < m->row.end && n <= blocks; n++)
+            a = block_end(m, l1, l2, cx, a, m->row.end, mid);
+        if (n <= blocks)
+            hi = mid;
+        else
+            lo = mid;
+    }
 
-    if (block_height <= 0 || block_height > height) {
-        fatal("Block height too small (%d).", block_height);
-        return;
+    /* Partition rows, leaving at least one row for remaining blocks */
+    for (a = b = m->row.start, i = 0; i <= index; i++) {
+        a = b;
+        if (i == blocks - 1)
+            b = m->row.end;
+        else
+            b = block_end(m, l1, l2, cx, a,
+                          m->row.end - (blocks - 1 - i), hi);
     }
 
     /* Update range */
-    m->row.start = m->row.start + index * block_height;
-    if (m->row.end > m->row.start + block_height)
-        m->row.end = m->row.start + block_height;
-#endif
+    m->row.start = a;
+    m->row.end = b;
+
+    free(l1);
+    free(l2);
 }
 
 /**
@@ -322,20 +606,252 @@ void hmatrix_row_range(hmatrix_t *m, char *s)
     m->row = parse_range(m->row, s, m->num);
 }
 
+/**
+ * Parse the name of a storage type
+ * @param name Name of type, e.g. float or uint8
+ * @return storage type or -1 if unknown
+ */
+int hmatrix_type(const char *name)
+{
+    if (!strcasecmp(name, "float"))
+        return VALUE_FLOAT;
+    if (!strcasecmp(name, "float16"))
+        return VALUE_FLOAT16;
+    if (!strcasecmp(name, "uint8"))
+        return VALUE_UINT8;
+    if (!strcasecmp(name, "uint16"))
+        return VALUE_UINT16;
+    if (!strcasecmp(name, "fixed"))
+        return VALUE_FIXED;
+    return -1;
+}
+
+/**
+ * Return the size of a value in a storage type
+ * @param type Storage type
+ * @return size in bytes
+ */
+size_t hmatrix_type_size(int type)
+{
+    switch (type) {
+    case VALUE_UINT8:
+        return sizeof(uint8_t);
+    case VALUE_FLOAT16:
+    case VALUE_UINT16:
+    case VALUE_FIXED:
+        return sizeof(uint16_t);
+    default:
+        return sizeof(float);
+    }
+}
+
+/**
+ * Set the storage type of the matrix. The type needs to be set before
+ * memory is allocated for the matrix.
+ * @param m Matrix object
+ * @param type Storage type
+ */
+void hmatrix_storage(hmatrix_t *m, int type)
+{
+    assert(m && !m->values);
+    m->type = type;
+}
+
+/**
+ * Convert a float to a half-precision float. The mantissa is rounded
+ * to the nearest even value and large values overflow to infinity.
+ * @param f Float value
+ * @return half-precision value
+ */
+static uint16_t float_to_half(float f)
+{
+    union { float f; uint32_t u; } v = { f };
+    uint32_t sign = (v.u >> 16) & 0x8000, mant = v.u & 0x7fffff;
+    int32_t exp = (int32_t) ((v.u >> 23) & 0xff) - 127 + 15;
+    uint32_t h, rem, half;
+    int shift;
+
+    /* Infinity and NaN */
+    if (((v.u >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+    if (exp >= 31)
+        return sign | 0x7c00;
+
+    /* Subnormal values */
+    if (exp <= 0) {
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        shift = 14 - exp;
+        h = mant >> shift;
+        rem = mant & ((1 << shift) - 1);
+        half = 1 << (shift - 1);
+        if (rem > half || (rem == half && (h & 1)))
+            h++;
+        return sign | h;
+    }
+
+    /* A carry of the rounding correctly increments the exponent */
+    h = sign | (exp << 10) | (mant >> 13);
+    rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+        h++;
+    return h;
+}
+
+/**
+ * Convert a half-precision float to a float
+ * @param h Half-precision value
+ * @return float value
+ */
+static float half_to_float(uint16_t h)
+{
+    union { float f; uint32_t u; } v;
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+
+    if (exp == 0) {
+        v.f = ldexpf(mant, -24);
+        v.u |= sign;
+    } else if (exp == 31) {
+        v.u = sign | 0x7f800000 | (mant << 13);
+    } else {
+        v.u = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+    }
+    return v.f;
+}
+
+/**
+ * Convert a float to an integer of a storage type. The value is
+ * rounded and clamped, where the largest integer represents NaN.
+ * @param f Float value
+ * @param max Largest integer of type
+ * @return integer value
+ */
+static inline uint32_t float_to_uint(float f, uint32_t max)
+{
+    if (isnan(f))
+        return max;
+    if (f <= 0)
+        return 0;
+    if (f >= max - 1)
+        return max - 1;
+    return (uint32_t) lrintf(f);
+}
+
+/**
+ * Store a value in a storage type
+ * @param type Storage type
+ * @param p Pointer to value
+ * @param f Float value
+ */
+void hmatrix_pack(int type, void *p, float f)
+{
+    switch (type) {
+    case VALUE_FLOAT16:
+        *(uint16_t *) p = float_to_half(f);
+        break;
+    case VALUE_UINT8:
+        *(uint8_t *) p = float_to_uint(f, UINT8_MAX);
+        break;
+    case VALUE_UINT16:
+        *(uint16_t *) p = float_to_uint(f, UINT16_MAX);
+        break;
+    case VALUE_FIXED:
+        *(uint16_t *) p = isnan(f) ? UINT16_MAX :
+            float_to_uint(MIN(MAX(f, 0), 1) * (UINT16_MAX - 1), UINT16_MAX);
+        break;
+    default:
+        *(float *) p = f;
+        break;
+    }
+}
+
+/**
+ * Load a value from a storage type
+ * @param type Storage type
+ * @param p Pointer to value
+ * @return float value
+ */
+float hmatrix_unpack(int type, const void *p)
+{
+    uint16_t u;
+
+    switch (type) {
+    case VALUE_FLOAT16:
+        return half_to_float(*(uint16_t *) p);
+    case VALUE_UINT8:
+        return *(uint8_t *) p == UINT8_MAX ? NAN : *(uint8_t *) p;
+    case VALUE_UINT16:
+        u = *(uint16_t *) p;
+        return u == UINT16_MAX ? NAN : u;
+    case VALUE_FIXED:
+        u = *(uint16_t *) p;
+        return u == UINT16_MAX ? NAN : u / (float) (UINT16_MAX - 1);
+    default:
+        return *(float *) p;
+    }
+}
+
+/**
+ * Load a value from the storage of the matrix
+ * @param m Matrix object
+ * @param idx Index of value
+ * @return value
+ */
+static inline float value_load(hmatrix_t *m, long idx)
+{
+    if (m->type == VALUE_FLOAT)
+        return ((float *) m->values)[idx];
+    return hmatrix_unpack(m->type,
+                          (char *) m->values + idx * hmatrix_type_size(m->type));
+}
+
+/**
+ * Store a value in the storage of the matrix
+ * @param m Matrix object
+ * @param idx Index of value
+ * @param f Value
+ */
+static inline void value_store(hmatrix_t *m, long idx, float f)
+{
+    if (m->type == VALUE_FLOAT)
+        ((float *) m->values)[idx] = f;
+    else
+        hmatrix_pack(m->type,
+                     (char *) m->values + idx * hmatrix_type_size(m->type), f);
+}
+
 /**
  * Allocate memory for matrix
  * @param m Matrix object
- * @return pointer to floats
+ * @return pointer to values
  */
-float *hmatrix_alloc(hmatrix_t *m)
+void *hmatrix_alloc(hmatrix_t *m)
 {
-    int cl, rl, k;
+    return hmatrix_block(m, m->row.start, m->row.end);
+}
 
-    /* Compute dimensions of matrix */
+/**
+ * Compute the layout of a block of rows of the matrix. If the block
+ * covers all rows of a symmetric matrix, a triangle is stored.
+ * @param m Matrix object
+ * @param start Start of block (inclusive)
+ * @param end End of block (exclusive)
+ */
+static void block_layout(hmatrix_t *m, long start, long end)
+{
+    long cl, rl, uc, ur;
+    hmatrix_t b;
+    hmatrixspec_t spec;
+
+    m->block.start = start;
+    m->block.end = end;
     cl = m->col.end - m->col.start;
-    rl = m->row.end - m->row.start;
+    rl = m->block.end - m->block.start;
 
-    if (m->col.end == m->row.end && m->col.start == m->row.start) {
+    if (m->col.end == m->block.end && m->col.start == m->block.start &&
+        m->row.end == m->block.end && m->row.start == m->block.start) {
         /* Symmetric matrix -> allocate triangle */
         m->triangular = TRUE;
         m->size = cl * (cl - 1) / 2 + cl;
@@ -345,222 +861,1126 @@ float *hmatrix_alloc(hmatrix_t *m)
         m->size = cl * rl;
     }
 
+    /* Count calculations of block */
+    b = *m;
+    b.row = m->block;
+    hmatrix_inferspec(&b, &spec);
+    m->calcs = spec.n;
+
+    /* Map duplicate strings and scale calculations */
+    if (m->dups) {
+        m->cmap = dedup_map(m, m->cmap, m->col, &uc);
+        m->rmap = dedup_map(m, m->rmap, m->block, &ur);
+        m->calcs = (long) ((double) spec.n * uc / cl * ur / rl);
+    }
+}
+
+/**
+ * Allocate memory for a block of rows of the matrix. Memory of a
+ * previous block is freed. If the block covers all rows of a
+ * symmetric matrix, only a triangle is allocated.
+ * @param m Matrix object
+ * @param start Start of block (inclusive)
+ * @param end End of block (exclusive)
+ * @return pointer to values
+ */
+void *hmatrix_block(hmatrix_t *m, long start, long end)
+{
+    long k;
+
+    assert(start >= m->row.start && end <= m->row.end && start < end);
+    assert(m->fd < 0);
+
+    if (m->values)
+        free(m->values);
+
+    /* Compute dimensions of block */
+    block_layout(m, start, end);
+
     /* Allocate memory */
-    m->values = calloc(sizeof(float), m->size);
+    m->values = calloc(hmatrix_type_size(m->type), m->size);
     if (!m->values) {
         error("Could not allocate matrix for similarity values");
         return NULL;
     }
 
-    hmatrixspec_t spec;
-    hmatrix_inferspec(m, &spec);
-    m->calcs = spec.n;
-
-    /* Initialize to NaN values and count calculations */
+    /* Initialize to NaN values */
     for (k = 0; k < m->size; k++)
-        m->values[k] = NAN;
+        value_store(m, k, NAN);
 
     return m->values;
 }
 
 /**
- * Set a value in the matrix
+ * Compute a fingerprint of the strings covered by the matrix.
  * @param m Matrix object
- * @param c Column index
- * @param r Row index
- * @param f Value
+ * @param s Array of string objects
+ * @return fingerprint
  */
-void hmatrix_set(hmatrix_t *m, int c, int r, float f)
+static uint64_t strings_fingerprint(hmatrix_t *m, hstring_t *s)
 {
-    int idx, i, j;
+    uint64_t h = m->num;
 
-    if (m->triangular) {
-        if (c - m->col.start > r - m->row.start) {
-            i = r - m->row.start;
-            j = c - m->col.start;
-        } else {
-            i = c - m->col.start;
-            j = r - m->row.start;
-        }
-        idx = ((j - i) + i * (m->col.end - m->col.start) - i * (i - 1) / 2);
-    } else {
-        idx = (r - m->row.start) * (m->col.end - m->col.start);
-        idx += c - m->col.start;
-    }
-
-    assert(idx < m->size);
-    m->values[idx] = f;
-
-    /* Set symmetric value if also wihin matrix range */
-    if (!m->triangular &&
-        r >= m->col.start && r < m->col.end &&
-        c >= m->row.start && c < m->row.end) {
-        /* This code is correct, although it looks strange. */
-        idx = (c - m->row.start) * (m->col.end - m->col.start);
-        idx += r - m->col.start;
+    for (long i = 0; i < m->num; i++) {
+        if ((i < m->col.start || i >= m->col.end) &&
+            (i < m->row.start || i >= m->row.end))
+            continue;
 
-        assert(idx < m->size);
-        m->values[idx] = f;
+        h = MurmurHash64B(&s[i].len, sizeof(s[i].len), h);
+        if (s[i].len > 0)
+            h ^= hstring_hash1(s[i]);
     }
-}
 
+    return h;
+}
 
 /**
- * Get a value from the matrix
+ * Back the matrix with a memory-mapped file. If the file does not
+ * exist, it is created and filled with NaN values. If the file exists
+ * and matches the matrix, configuration and strings, the computation
+ * is resumed and only NaN values are computed. The file is
+ * synchronized periodically while the matrix is computed.
  * @param m Matrix object
- * @param c Column coordinate
- * @param r Row coordinate
- * @return f Value
+ * @param s Array of string objects
+ * @param file Name of file
+ * @param config Fingerprint of configuration
+ * @param sync Interval between checkpoints in seconds
+ * @return pointer to values
  */
-float hmatrix_get(hmatrix_t *m, int c, int r)
+void *hmatrix_mmap(hmatrix_t *m, hstring_t *s, char *file,
+                   uint64_t config, long sync)
 {
-    int idx, i, j;
+    mmap_header_t h, f;
+    struct stat st;
+    long len, k, done = 0;
+    char *map;
 
-    if (m->triangular) {
-        if (c - m->col.start > r - m->row.start) {
-            i = r - m->row.start;
-            j = c - m->col.start;
-        } else {
-            i = c - m->col.start;
-            j = r - m->row.start;
+    assert(m && s && file && !m->values);
+
+    /* Compute dimensions of matrix */
+    block_layout(m, m->row.start, m->row.end);
+    len = MMAP_HEADER + m->size * hmatrix_type_size(m->type);
+
+    /* Prepare header */
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MMAP_MAGIC, sizeof(h.magic));
+    h.version = MMAP_VERSION;
+    h.triangular = m->triangular;
+    h.num = m->num;
+    h.col[0] = m->col.start;
+    h.col[1] = m->col.end;
+    h.row[0] = m->row.start;
+    h.row[1] = m->row.end;
+    h.size = m->size;
+    h.config = config;
+    h.input = strings_fingerprint(m, s);
+    h.type = m->type;
+
+    m->fd = open(file, O_RDWR | O_CREAT, 0644);
+    if (m->fd < 0 || fstat(m->fd, &st) < 0) {
+        error("Could not open matrix file '%s'", file);
+        return NULL;
+    }
+
+    /* Check header of existing file. Files without magic are incomplete */
+    memset(&f, 0, sizeof(f));
+    if (st.st_size >= MMAP_HEADER &&
+        pread(m->fd, &f, sizeof(f), 0) == sizeof(f) &&
+        !memcmp(f.magic, MMAP_MAGIC, sizeof(f.magic))) {
+        if (memcmp(&f, &h, sizeof(h)) || st.st_size != len) {
+            fatal("Matrix file '%s' does not match configuration", file);
+            return NULL;
         }
-        idx = ((j - i) + i * (m->col.end - m->row.start) - i * (i - 1) / 2);
-    } else {
-        idx = (r - m->row.start) * (m->col.end - m->col.start);
-        idx += c - m->col.start;
+        m->resume = TRUE;
+    } else if (ftruncate(m->fd, 0) < 0 || ftruncate(m->fd, len) < 0) {
+        error("Could not resize matrix file '%s'", file);
+        return NULL;
     }
 
-    assert(idx < m->size);
-    return m->values[idx];
+    map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+    if (map == MAP_FAILED) {
+        error("Could not map matrix file '%s'", file);
+        return NULL;
+    }
+    m->values = map + MMAP_HEADER;
+    m->sync = sync;
+    m->synced = time_stamp();
+
+    if (m->resume) {
+        for (k = 0; k < m->size; k++)
+            done += !isnan(value_load(m, k));
+        info_msg(1, "Resuming matrix with %ld of %ld values computed.",
+                 done, m->size);
+        return m->values;
+    }
+
+    /* Initialize to NaN values and write header last */
+    for (k = 0; k < m->size; k++)
+        value_store(m, k, NAN);
+    msync(map, len, MS_SYNC);
+    memcpy(map, &h, sizeof(h));
+    msync(map, MMAP_HEADER, MS_SYNC);
+
+    return m->values;
 }
 
 /**
- * Compute similarity measure and fill matrix
+ * Write a checkpoint of a memory-mapped matrix to disk.
  * @param m Matrix object
- * @param s Array of string objects
- * @param measure Similarity measure
  */
-void hmatrix_compute(hmatrix_t *m, hstring_t *s,
-                     double (*measure) (hstring_t, hstring_t))
+void hmatrix_sync(hmatrix_t *m)
 {
-    assert(m);
-
-    int cnt = 0, n;
-    double ts, ts1 = time_stamp(), ts2 = ts1;
-    float f;
+    if (m->fd < 0 || !m->values)
+        return;
 
-    n = (m->col.end - m->col.start) * (m->row.end - m->row.start);
+    if (msync((char *) m->values - MMAP_HEADER,
+              MMAP_HEADER + m->size * hmatrix_type_size(m->type),
+              MS_SYNC) < 0)
+        warning("Could not synchronize matrix file");
 
-#ifdef HAVE_OPENMP
-#pragma omp parallel for private(ts)
-#endif
-    for (int k = 0; k < n; k++) {
-        int c = k / (m->row.end - m->row.start) + m->col.start;
-        int r = k % (m->row.end - m->row.start) + m->row.start;
+    m->synced = time_stamp();
+}
 
-        /* Skip values that have been computed earlier */
-        f = hmatrix_get(m, c, r);
-        if (!isnan(f))
-            continue;
+/**
+ * Determine the index of a cell in the storage of the matrix
+ * @param m Matrix object
+ * @param c Column index
+ * @param r Row index
+ * @return index of cell
+ */
+static inline long value_index(hmatrix_t *m, long c, long r)
+{
+    long i, j, cl = m->col.end - m->col.start;
 
-        /* Set value in matrix */
-        f = measure(s[c], s[r]);
-        hmatrix_set(m, c, r, f);
+    if (!m->triangular)
+        return (r - m->block.start) * cl + c - m->col.start;
 
-        if (verbose || log_line) {
-            /*
-             * Update internal counter. Note that we have slightly more
-             * calculations as expected, since we don't lock the matrix.
-             * Moreover, this update is not thread-safe and the progress
-             * bar might not be correct.
-             */
-            if (cnt < m->calcs)
-                cnt++;
+    /* Rows of the triangle are stored consecutively */
+    i = MIN(c, r) - m->col.start;
+    j = MAX(c, r) - m->col.start;
+    return (j - i) + i * cl - i * (i - 1) / 2;
+}
 
-            /* Continue if less than 100ms have passed */
-            ts = time_stamp();
-            if (ts - ts1 < 0.1)
-                continue;
+/**
+ * Map a column to its first duplicate
+ * @param m Matrix object
+ * @param c Column index
+ * @return column index
+ */
+static inline long col_dup(hmatrix_t *m, long c)
+{
+    return m->cmap ? m->cmap[c - m->col.start] : c;
+}
 
-            /* Lock only if something is displayed */
-#ifdef HAVE_OPENMP
-#pragma omp critical
+/**
+ * Map a row to its first duplicate
+ * @param m Matrix object
+ * @param r Row index
+ * @return row index
+ */
+static inline long row_dup(hmatrix_t *m, long r)
+{
+    return m->rmap ? m->rmap[r - m->block.start] : r;
+}
+
+/**
+ * Set a value in the matrix
+ * @param m Matrix object
+ * @param c Column index
+ * @param r Row index
+ * @param f Value
+ */
+void hmatrix_set(hmatrix_t *m, long c, long r, float f)
+{
+    long idx = value_index(m, col_dup(m, c), row_dup(m, r));
+
+    assert(idx < m->size);
+    value_store(m, idx, f);
+
+    /* Set symmetric value if also wihin matrix range */
+    if (!m->triangular &&
+        r >= m->col.start && r < m->col.end &&
+        c >= m->block.start && c < m->block.end) {
+        /* This code is correct, although it looks strange. */
+        idx = value_index(m, col_dup(m, r), row_dup(m, c));
+
+        assert(idx < m->size);
+        value_store(m, idx, f);
+    }
+}
+
+
+/**
+ * Get a value from the matrix
+ * @param m Matrix object
+ * @param c Column coordinate
+ * @param r Row coordinate
+ * @return f Value
+ */
+float hmatrix_get(hmatrix_t *m, long c, long r)
+{
+    long idx = value_index(m, col_dup(m, c), row_dup(m, r));
+
+    assert(idx < m->size);
+    return value_load(m, idx);
+}
+
+/**
+ * Enable the computation of the k nearest neighbors. Instead of all
+ * similarity values, only the k most similar columns of each row are
+ * kept in a sparse matrix. The string of a row is not considered as
+ * its own neighbor.
+ * @param m Matrix object
+ * @param k Number of neighbors
+ * @param descending Flag for larger values being more similar
+ */
+void hmatrix_knn(hmatrix_t *m, long k, int descending)
+{
+    assert(m && k > 0);
+
+    block_layout(m, m->row.start, m->row.end);
+    m->size = 0;
+    m->knn = k;
+    m->descending = descending;
+}
+
+/**
+ * Enable the computation of similar pairs. Instead of all similarity
+ * values, only the values within a threshold are kept in a sparse
+ * matrix. The string of a row is not paired with itself.
+ * @param m Matrix object
+ * @param t Threshold for similarity values
+ * @param descending Flag for larger values being more similar
+ */
+void hmatrix_threshold(hmatrix_t *m, double t, int descending)
+{
+    assert(m && !isnan(t));
+
+    block_layout(m, m->row.start, m->row.end);
+    m->size = 0;
+    m->threshold = t;
+    m->descending = descending;
+}
+
+/**
+ * Estimate the memory footprint of a string in bytes
+ * @param x String object
+ * @return number of bytes
+ */
+static long string_bytes(hstring_t x)
+{
+    switch (x.type) {
+    case TYPE_TOKEN:
+        return sizeof(hstring_t) + x.len * sizeof(sym_t);
+    case TYPE_BIT:
+        return sizeof(hstring_t) + x.len / 8 + 1;
+    case TYPE_BYTE:
+    default:
+        return sizeof(hstring_t) + x.len;
+    }
+}
+
+/**
+ * Determine the side length of the tiles used for computing the
+ * matrix. The tiles are chosen such that the strings of a row and
+ * a column tile fit into the L2 cache.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @return side length of tiles
+ */
+static int tile_size(hmatrix_t *m, hstring_t *s)
+{
+    long cache = 0, bytes = 0, n = 0, t;
+
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
 #endif
-            {
-                /* Update progress bar every 100ms */
-                if (verbose) {
-                    prog_bar(0, m->calcs, cnt);
-                    ts1 = ts;
-                }
+    if (cache <= 0)
+        cache = L2_CACHE_SIZE;
+
+    /* Average footprint of strings in the matrix */
+    for (long i = m->col.start; i < m->col.end; i++, n++)
+        bytes += string_bytes(s[i]);
+    for (long i = m->block.start; i < m->block.end; i++, n++)
+        bytes += string_bytes(s[i]);
+
+    /* Row and column tile need to fit into the cache */
+    t = cache / (2 * MAX(bytes / MAX(n, 1), 1));
+    return (int) MIN(MAX(t, TILE_MIN), TILE_MAX);
+}
 
-                /* Print log line every minute if enabled */
-                if (log_line && ts - ts2 > 60) {
-                    log_print(0, m->calcs, cnt);
-                    ts2 = ts;
-                }
+/**
+ * Check whether a string precedes another in a schedule. Longer
+ * strings come first and ties are broken by the index.
+ * @param s Array of string objects
+ * @param a Index of first string
+ * @param b Index of second string
+ * @return true if a precedes b or a equals b
+ */
+static inline int order_le(hstring_t *s, long a, long b)
+{
+    return s[a].len > s[b].len || (s[a].len == s[b].len && a <= b);
+}
+
+/**
+ * Check whether a cell has a mirrored cell at the diagonal of the
+ * matrix. In contrast to cell_mirrored(), all rows are considered, such
+ * that the cell is oriented in the same way for any block of rows.
+ * @param m Matrix object
+ * @param c Column index
+ * @param r Row index
+ * @return true if the cell is symmetric
+ */
+static inline int cell_symmetric(hmatrix_t *m, long c, long r)
+{
+    return r >= m->col.start && r < m->col.end &&
+        c >= m->row.start && c < m->row.end;
+}
+
+/**
+ * Check whether a cell is mirrored at the diagonal within the matrix.
+ * Only the rows of the current block are considered. If duplicates
+ * are mapped, the mirrored cell needs to hold first duplicates.
+ * @param m Matrix object
+ * @param c Column index
+ * @param r Row index
+ * @return true if the cell is mirrored
+ */
+static inline int cell_mirrored(hmatrix_t *m, long c, long r)
+{
+    return r >= m->col.start && r < m->col.end &&
+        c >= m->block.start && c < m->block.end &&
+        col_dup(m, r) == r && row_dup(m, c) == c;
+}
+
+/**
+ * Compute the similarity values of cells in one row. If the measure
+ * provides a batched comparison, the string of the row is compared with
+ * the strings of all columns at once. The batched comparison is only
+ * available for symmetric measures, such that the order of the strings
+ * does not matter. Otherwise, symmetric cells are computed with the
+ * string of lower index as first argument, such that the values depend
+ * neither on the schedule nor on the block of rows.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param r Row index
+ * @param cols Column indices
+ * @param num Number of cells
+ * @param measure Similarity measure
+ * @param many Batched similarity measure or NULL
+ * @param out Array of similarity values
+ */
+static void compute_row(hmatrix_t *m, hstring_t *s, long r, long *cols,
+                        int num, double (*measure) (hstring_t, hstring_t),
+                        int (*many) (hstring_t, hstring_t *, int, float *),
+                        float *out)
+{
+    hstring_t y[BATCH_SIZE];
+    long c;
+    int k;
+
+    if (many) {
+        for (k = 0; k < num; k++)
+            y[k] = s[cols[k]];
+        if (many(s[r], y, num, out))
+            return;
+    }
+
+    for (k = 0; k < num; k++) {
+        c = cols[k];
+        out[k] = cell_symmetric(m, c, r) ?
+            measure(s[MIN(r, c)], s[MAX(r, c)]) : measure(s[c], s[r]);
+    }
+}
+
+/**
+ * Compute the similarity values of one tile of the matrix. The values
+ * are directly written to the storage of the matrix. Of two mirrored
+ * cells only the one whose column precedes in the schedule is visited.
+ * The cells of each row are collected and computed in batches (see
+ * compute_row()).
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param many Batched similarity measure or NULL
+ * @param sc Schedule
+ * @param tl Tile of schedule
+ * @return number of computed values
+ */
+static long compute_tile(hmatrix_t *m, hstring_t *s,
+                         double (*measure) (hstring_t, hstring_t),
+                         int (*many) (hstring_t, hstring_t *, int, float *),
+                         sched_t *sc, tile_t *tl)
+{
+    long re = MIN(tl->r + sc->t, sc->nr), ce = MIN(tl->c + sc->t, sc->nc);
+    long cnt = 0, idx[BATCH_SIZE], cols[BATCH_SIZE], r, c, j;
+    char mirror[BATCH_SIZE];
+    float f[BATCH_SIZE];
+    int k, num;
+
+    for (long i = tl->r; i < re; i++) {
+        r = sc->rows[i];
+        for (j = tl->c; j < ce;) {
+            /* Collect cells of the row */
+            for (num = 0; j < ce && num < BATCH_SIZE; j++) {
+                c = sc->cols[j];
+                mirror[num] = cell_mirrored(m, c, r);
+                if (mirror[num] && !order_le(s, r, c))
+                    continue;
+
+                idx[num] = value_index(m, c, r);
+                if (m->resume && !isnan(value_load(m, idx[num])))
+                    continue;
+                cols[num++] = c;
             }
+
+            compute_row(m, s, r, cols, num, measure, many, f);
+
+            /* Set symmetric value if also within matrix range */
+            for (k = 0; k < num; k++) {
+                if (mirror[k] && !m->triangular)
+                    value_store(m, value_index(m, r, cols[k]), f[k]);
+                value_store(m, idx[k], f[k]);
+            }
+
+            cnt += num;
         }
     }
 
-    if (verbose) {
-        prog_bar(0, m->calcs, m->calcs);
+    return cnt;
+}
+
+/**
+ * Compare two strings by decreasing length and increasing index
+ * @param x First string
+ * @param y Second string
+ * @return comparison result
+ */
+static int order_cmp(const void *x, const void *y)
+{
+    order_t a = *(order_t *) x, b = *(order_t *) y;
+
+    if (a.len != b.len)
+        return a.len > b.len ? -1 : 1;
+    return (a.idx > b.idx) - (a.idx < b.idx);
+}
+
+/**
+ * Compare two tiles by decreasing cost and increasing position
+ * @param x First tile
+ * @param y Second tile
+ * @return comparison result
+ */
+static int tile_cmp(const void *x, const void *y)
+{
+    tile_t a = *(tile_t *) x, b = *(tile_t *) y;
+
+    if (a.cost != b.cost)
+        return a.cost > b.cost ? -1 : 1;
+    if (a.r != b.r)
+        return a.r > b.r ? 1 : -1;
+    return (a.c > b.c) - (a.c < b.c);
+}
+
+/**
+ * Order a range of strings by decreasing length. Duplicate strings
+ * are skipped if a map is given.
+ * @param s Array of string objects
+ * @param r Range of strings
+ * @param map Map of duplicates or NULL
+ * @param n Return pointer to number of strings
+ * @return array of indices
+ */
+static long *sched_order(hstring_t *s, range_t r, long *map, long *n)
+{
+    long i, *idx;
+    order_t *o;
+
+    o = malloc((r.end - r.start) * sizeof(order_t));
+    idx = malloc((r.end - r.start) * sizeof(long));
+    if (!o || !idx) {
+        free(o);
+        free(idx);
+        return NULL;
     }
 
-    if (log_line) {
-        log_print(0, m->calcs, m->calcs);
+    for (*n = 0, i = r.start; i < r.end; i++) {
+        if (map && map[i - r.start] != i)
+            continue;
+        o[*n].len = s[i].len;
+        o[(*n)++].idx = i;
+    }
+
+    qsort(o, *n, sizeof(order_t), order_cmp);
+    for (i = 0; i < *n; i++)
+        idx[i] = o[i].idx;
+
+    free(o);
+    return idx;
+}
+
+/**
+ * Sum the lengths of the strings in the tiles of a schedule
+ * @param s Array of string objects
+ * @param idx Ordered indices of strings
+ * @param n Number of indices
+ * @param t Side length of tiles
+ * @return array of sums
+ */
+static double *sched_sums(hstring_t *s, long *idx, long n, long t)
+{
+    double *w = calloc((n + t - 1) / t, sizeof(double));
+
+    /* Each comparison has a constant overhead */
+    for (long i = 0; w && i < n; i++)
+        w[i / t] += s[idx[i]].len + 1;
+
+    return w;
+}
+
+/**
+ * Free a schedule
+ * @param sc Schedule
+ */
+static void sched_free(sched_t *sc)
+{
+    if (!sc)
+        return;
+
+    free(sc->rows);
+    free(sc->cols);
+    free(sc->tiles);
+    free(sc);
+}
+
+/**
+ * Create a schedule for computing the matrix. The rows and columns
+ * are ordered by decreasing length of the strings, such that long
+ * strings are grouped in tiles. The cost of a tile is estimated from
+ * the lengths of its strings and the tiles are ordered by decreasing
+ * cost. If rows and columns coincide, tiles that are completely
+ * mirrored are skipped.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @return schedule
+ */
+static sched_t *sched_init(hmatrix_t *m, hstring_t *s)
+{
+    long tr, tc, i, j, k;
+    double *wr, *wc;
+    sched_t *sc;
+    int sym;
+
+    sc = calloc(1, sizeof(sched_t));
+    if (!sc)
+        return NULL;
+
+    sc->rows = sched_order(s, m->block, m->rmap, &sc->nr);
+    sc->cols = sched_order(s, m->col, m->cmap, &sc->nc);
+    sym = m->block.start == m->col.start && m->block.end == m->col.end;
+
+    /* Determine tiles and limit their number */
+    sc->t = tile_size(m, s);
+    while ((tr = (sc->nr + sc->t - 1) / sc->t) *
+           (tc = (sc->nc + sc->t - 1) / sc->t) > TILE_COUNT)
+        sc->t *= 2;
+
+    wr = sched_sums(s, sc->rows, sc->nr, sc->t);
+    wc = sched_sums(s, sc->cols, sc->nc, sc->t);
+    sc->tiles = malloc(tr * tc * sizeof(tile_t));
+    if (!sc->rows || !sc->cols || !wr || !wc || !sc->tiles) {
+        error("Could not allocate schedule for matrix");
+        sched_free(sc);
+        sc = NULL;
+        goto out;
+    }
+
+    for (k = 0, i = 0; i < tr; i++) {
+        for (j = sym ? i : 0; j < tc; j++, k++) {
+            sc->tiles[k].r = i * sc->t;
+            sc->tiles[k].c = j * sc->t;
+            sc->tiles[k].cost = wr[i] * wc[j] / (sym && i == j ? 2 : 1);
+        }
+    }
+    sc->num = k;
+    qsort(sc->tiles, sc->num, sizeof(tile_t), tile_cmp);
+
+  out:
+    free(wr);
+    free(wc);
+    return sc;
+}
+
+/**
+ * Check whether an entry is more similar than another. Ties are broken
+ * by the column index, such that the result is deterministic.
+ * @param a First entry
+ * @param b Second entry
+ * @param d Flag for larger values being more similar
+ * @return true if a is more similar than b
+ */
+static inline int entry_better(entry_t a, entry_t b, int d)
+{
+    if (a.val != b.val)
+        return d ? a.val > b.val : a.val < b.val;
+    return a.col < b.col;
+}
+
+/**
+ * Compare two entries by ascending values
+ * @param x First entry
+ * @param y Second entry
+ * @return comparison result
+ */
+static int entry_cmp_asc(const void *x, const void *y)
+{
+    entry_t a = *(entry_t *) x, b = *(entry_t *) y;
+    return entry_better(a, b, FALSE) ? -1 : entry_better(b, a, FALSE);
+}
+
+/**
+ * Compare two entries by descending values
+ * @param x First entry
+ * @param y Second entry
+ * @return comparison result
+ */
+static int entry_cmp_desc(const void *x, const void *y)
+{
+    entry_t a = *(entry_t *) x, b = *(entry_t *) y;
+    return entry_better(a, b, TRUE) ? -1 : entry_better(b, a, TRUE);
+}
+
+/**
+ * Compare two entries by ascending column indices
+ * @param x First entry
+ * @param y Second entry
+ * @return comparison result
+ */
+static int entry_cmp_col(const void *x, const void *y)
+{
+    long a = ((entry_t *) x)->col, b = ((entry_t *) y)->col;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Add an entry to a bounded heap of nearest neighbors. The root of
+ * the heap holds the least similar entry, which is replaced if the
+ * heap is full and the new entry is more similar.
+ * @param h Heap of entries
+ * @param n Number of entries in heap
+ * @param k Maximum number of entries
+ * @param e Entry to add
+ * @param d Flag for larger values being more similar
+ */
+static void heap_push(entry_t *h, long *n, long k, entry_t e, int d)
+{
+    long i, j;
+
+    if (*n < k) {
+        /* Sift up */
+        for (i = (*n)++; i > 0 && entry_better(h[(i - 1) / 2], e, d);
+             i = (i - 1) / 2)
+            h[i] = h[(i - 1) / 2];
+        h[i] = e;
+        return;
+    }
+
+    if (!entry_better(e, h[0], d))
+        return;
+
+    /* Sift down */
+    for (i = 0; (j = 2 * i + 1) < k; i = j) {
+        if (j + 1 < k && entry_better(h[j], h[j + 1], d))
+            j++;
+        if (!entry_better(e, h[j], d))
+            break;
+        h[i] = h[j];
+    }
+    h[i] = e;
+}
+
+/**
+ * Free thread-local buffers of sparse similarity values
+ * @param sb Array of buffers
+ * @param t Number of threads
+ */
+static void sbuf_free(sbuf_t *sb, int t)
+{
+    for (int i = 0; sb && i < t; i++) {
+        free(sb[i].heaps);
+        free(sb[i].lens);
+        free(sb[i].pairs);
     }
+    free(sb);
 }
 
+/**
+ * Allocate thread-local buffers of sparse similarity values
+ * @param m Matrix object
+ * @param t Number of threads
+ * @return array of buffers
+ */
+static sbuf_t *sbuf_alloc(hmatrix_t *m, int t)
+{
+    long rl = m->row.end - m->row.start;
+    sbuf_t *sb = calloc(t, sizeof(sbuf_t));
+
+    if (!sb) {
+        error("Could not allocate buffers for sparse matrix");
+        return NULL;
+    }
+
+    for (int i = 0; m->knn > 0 && i < t; i++) {
+        sb[i].heaps = malloc(rl * m->knn * sizeof(entry_t));
+        sb[i].lens = calloc(rl, sizeof(long));
+        if (!sb[i].heaps || !sb[i].lens) {
+            error("Could not allocate heaps for nearest neighbors");
+            sbuf_free(sb, t);
+            return NULL;
+        }
+    }
+
+    return sb;
+}
 
 /**
- * Benchmark computation of similarity measure
+ * Add a similarity value to a thread-local buffer. The value is either
+ * added to the heap of nearest neighbors of the row or appended to
+ * the list of pairs if it is within the threshold.
+ * @param m Matrix object
+ * @param sb Buffer of thread
+ * @param r Row index
+ * @param e Column index and similarity value
+ */
+static void sbuf_add(hmatrix_t *m, sbuf_t *sb, long r, entry_t e)
+{
+    long i = r - m->row.start;
+    pair_t *p;
+
+    if (m->knn > 0) {
+        heap_push(sb->heaps + i * m->knn, sb->lens + i, m->knn, e,
+                  m->descending);
+        return;
+    }
+
+    if (m->descending ? e.val < m->threshold : e.val > m->threshold)
+        return;
+
+    if (sb->num == sb->size) {
+        p = realloc(sb->pairs, MAX(2 * sb->size, 1024) * sizeof(pair_t));
+        if (!p) {
+            error("Could not allocate pairs for sparse matrix");
+            return;
+        }
+        sb->pairs = p;
+        sb->size = MAX(2 * sb->size, 1024);
+    }
+
+    sb->pairs[sb->num].row = r;
+    sb->pairs[sb->num].e = e;
+    sb->num++;
+}
+
+/**
+ * Allocate a sparse matrix
+ * @param rows Number of rows
+ * @param nnz Maximum number of values
+ * @return sparse matrix
+ */
+hsparse_t *hmatrix_sparse_alloc(long rows, long nnz)
+{
+    hsparse_t *sp = calloc(1, sizeof(hsparse_t));
+
+    if (!sp || !(sp->ptr = calloc(rows + 1, sizeof(long))) ||
+        !(sp->cols = malloc(MAX(nnz, 1) * sizeof(long))) ||
+        !(sp->vals = malloc(MAX(nnz, 1) * sizeof(float)))) {
+        error("Could not allocate sparse matrix");
+        if (sp) {
+            free(sp->ptr);
+            free(sp->cols);
+        }
+        free(sp);
+        return NULL;
+    }
+
+    return sp;
+}
+
+/**
+ * Merge the heaps of all threads into a sparse matrix. The neighbors
+ * of each row are sorted by their column index.
+ * @param m Matrix object
+ * @param sb Array of buffers
+ * @param t Number of threads
+ */
+static void knn_merge(hmatrix_t *m, sbuf_t *sb, int t)
+{
+    long rl = m->row.end - m->row.start, i, j, n, nnz = 0;
+    entry_t *buf;
+    hsparse_t *sp;
+
+    sp = hmatrix_sparse_alloc(rl, rl * m->knn);
+    buf = malloc(t * m->knn * sizeof(entry_t));
+    if (!sp || !buf) {
+        error("Could not merge nearest neighbors");
+        free(buf);
+        return;
+    }
+
+    for (i = 0; i < rl; i++) {
+        /* Collect candidates of all threads */
+        for (n = 0, j = 0; j < t; j++) {
+            memcpy(buf + n, sb[j].heaps + i * m->knn,
+                   sb[j].lens[i] * sizeof(entry_t));
+            n += sb[j].lens[i];
+        }
+
+        /* Select most similar entries and sort by columns */
+        qsort(buf, n, sizeof(entry_t),
+              m->descending ? entry_cmp_desc : entry_cmp_asc);
+        n = MIN(n, m->knn);
+        qsort(buf, n, sizeof(entry_t), entry_cmp_col);
+
+        for (j = 0; j < n; j++, nnz++) {
+            sp->cols[nnz] = buf[j].col;
+            sp->vals[nnz] = buf[j].val;
+        }
+        sp->ptr[i + 1] = nnz;
+    }
+
+    sp->nnz = nnz;
+    m->sparse = sp;
+    m->size = nnz;
+    free(buf);
+}
+
+/**
+ * Merge the pairs of all threads into a sparse matrix. The pairs are
+ * counted for each row and then sorted by their column index.
+ * @param m Matrix object
+ * @param sb Array of buffers
+ * @param t Number of threads
+ */
+static void pairs_merge(hmatrix_t *m, sbuf_t *sb, int t)
+{
+    long rl = m->row.end - m->row.start, i, j, nnz = 0, *pos;
+    entry_t *buf;
+    hsparse_t *sp;
+
+    for (j = 0; j < t; j++)
+        nnz += sb[j].num;
+
+    sp = hmatrix_sparse_alloc(rl, nnz);
+    buf = malloc(MAX(nnz, 1) * sizeof(entry_t));
+    pos = malloc((rl + 1) * sizeof(long));
+    if (!sp || !buf || !pos) {
+        error("Could not merge pairs of sparse matrix");
+        free(buf);
+        free(pos);
+        return;
+    }
+
+    /* Count pairs of each row */
+    for (j = 0; j < t; j++)
+        for (i = 0; i < sb[j].num; i++)
+            sp->ptr[sb[j].pairs[i].row - m->row.start + 1]++;
+    for (i = 0; i < rl; i++)
+        sp->ptr[i + 1] += sp->ptr[i];
+
+    /* Distribute pairs to rows */
+    memcpy(pos, sp->ptr, (rl + 1) * sizeof(long));
+    for (j = 0; j < t; j++)
+        for (i = 0; i < sb[j].num; i++)
+            buf[pos[sb[j].pairs[i].row - m->row.start]++] = sb[j].pairs[i].e;
+
+    for (i = 0; i < rl; i++)
+        qsort(buf + sp->ptr[i], sp->ptr[i + 1] - sp->ptr[i],
+              sizeof(entry_t), entry_cmp_col);
+
+    for (i = 0; i < nnz; i++) {
+        sp->cols[i] = buf[i].col;
+        sp->vals[i] = buf[i].val;
+    }
+
+    sp->nnz = nnz;
+    m->sparse = sp;
+    m->size = nnz;
+    free(buf);
+    free(pos);
+}
+
+/**
+ * Compute the similarity values of one tile of the matrix and add
+ * them to the sparse buffer of a thread.
  * @param m Matrix object
  * @param s Array of string objects
  * @param measure Similarity measure
- * @param t Time to run benchmark in seconds
- * @return Number of computations
+ * @param many Batched similarity measure or NULL
+ * @param sc Schedule
+ * @param tl Tile of schedule
+ * @param sb Buffer of the thread
+ * @return number of computed values
  */
-float hmatrix_benchmark(hmatrix_t *m, hstring_t *s,
-                        double (*measure) (hstring_t, hstring_t), double t)
+static long sparse_tile(hmatrix_t *m, hstring_t *s,
+                        double (*measure) (hstring_t, hstring_t),
+                        int (*many) (hstring_t, hstring_t *, int, float *),
+                        sched_t *sc, tile_t *tl, sbuf_t *sb)
+{
+    long re = MIN(tl->r + sc->t, sc->nr), ce = MIN(tl->c + sc->t, sc->nc);
+    long cnt = 0, cols[BATCH_SIZE], r, c, j;
+    char mirror[BATCH_SIZE];
+    float f[BATCH_SIZE];
+    int k, num;
+    entry_t e;
+
+    for (long i = tl->r; i < re; i++) {
+        r = sc->rows[i];
+        for (j = tl->c; j < ce;) {
+            /* Collect cells of the row */
+            for (num = 0; j < ce && num < BATCH_SIZE; j++) {
+                c = sc->cols[j];
+                mirror[num] = cell_mirrored(m, c, r);
+                if (!mirror[num] || order_le(s, r, c))
+                    cols[num++] = c;
+            }
+
+            /* Compute in the same order as for the full matrix */
+            compute_row(m, s, r, cols, num, measure, many, f);
+            cnt += num;
+
+            for (k = 0; k < num; k++) {
+                c = cols[k];
+                e.val = f[k];
+                if (c == r || isnan(e.val))
+                    continue;
+
+                e.col = c;
+                sbuf_add(m, sb, r, e);
+                if (mirror[k]) {
+                    e.col = r;
+                    sbuf_add(m, sb, c, e);
+                }
+            }
+        }
+    }
+
+    return cnt;
+}
+
+/**
+ * Compute similarity measure and fill matrix. The matrix is traversed
+ * in tiles, such that the strings of a tile stay in the cache. The
+ * tiles are scheduled dynamically starting with the most expensive
+ * ones (see sched_init()). Only the cells that need to be computed are
+ * visited. If the matrix holds a block of rows, only this block is
+ * computed.
+ * @param m Matrix object
+ * @param s Array of string objects
+ * @param measure Similarity measure
+ * @param many Batched similarity measure or NULL
+ */
+void hmatrix_compute(hmatrix_t *m, hstring_t *s,
+                     double (*measure) (hstring_t, hstring_t),
+                     int (*many) (hstring_t, hstring_t *, int, float *))
 {
     assert(m);
-    uint64_t l = 0;
-    int mt = 0;
-    double ts = time_stamp();
 
+    long cnt = 0;
+    double ts1 = time_stamp(), ts2 = ts1;
+    sbuf_t *sb = NULL;
+    sched_t *sc;
+    int nt = 1;
+
+    /* Allocate thread-local buffers for sparse matrices */
+    if (m->knn > 0 || !isnan(m->threshold)) {
 #ifdef HAVE_OPENMP
-    mt = omp_get_max_threads();
+        nt = omp_get_max_threads();
 #endif
+        sb = sbuf_alloc(m, nt);
+        if (!sb)
+            return;
+    }
+
+    /* Schedule tiles */
+    sc = sched_init(m, s);
+    if (!sc) {
+        sbuf_free(sb, nt);
+        return;
+    }
 
-    /*
-     * Naive implementation of a while loop. The loop terminates
-     * after roughly t seconds by setting k to the maximum value.
-     */
 #ifdef HAVE_OPENMP
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic, 1)
 #endif
-    for (uint64_t k = 0; k < UINT64_MAX - mt; k++) {
+    for (long k = 0; k < sc->num; k++) {
+        long n;
+        if (sb) {
+#ifdef HAVE_OPENMP
+            n = sparse_tile(m, s, measure, many, sc, sc->tiles + k,
+                            sb + omp_get_thread_num());
+#else
+            n = sparse_tile(m, s, measure, many, sc, sc->tiles + k, sb);
+#endif
+        } else {
+            n = compute_tile(m, s, measure, many, sc, sc->tiles + k);
+        }
 
-        /* Select random pair of strings */
-        int c = lrand48() % (m->col.end - m->col.start) + m->col.start;
-        int r = lrand48() % (m->row.end - m->row.start) + m->row.start;
+        /* Write checkpoint of memory-mapped matrix */
+        if (m->sync > 0 && time_stamp() - m->synced > m->sync) {
+#ifdef HAVE_OPENMP
+#pragma omp critical (hmatrix_sync)
+#endif
+            if (time_stamp() - m->synced > m->sync)
+                hmatrix_sync(m);
+        }
+
+        if (verbose || log_line) {
+#ifdef HAVE_OPENMP
+#pragma omp atomic
+#endif
+            cnt += n;
 
-        /* Calculate similarity value */
-        measure(s[c], s[r]);
+            /* Continue if less than 100ms have passed */
+            double ts = time_stamp();
+            if (ts - ts1 < 0.1)
+                continue;
 
+            /* Lock only if something is displayed */
 #ifdef HAVE_OPENMP
 #pragma omp critical
 #endif
-        {
-            l++;
-            if (time_stamp() - ts > t)
-                k = UINT64_MAX - mt;
+            {
+                /* Update progress bar every 100ms */
+                if (verbose) {
+                    prog_bar(0, m->calcs, cnt);
+                    ts1 = ts;
+                }
+
+                /* Print log line every minute if enabled */
+                if (log_line && ts - ts2 > 60) {
+                    log_print(0, m->calcs, cnt);
+                    ts2 = ts;
+                }
+            }
         }
     }
 
-    return (float) l;
-}
+    if (verbose) {
+        prog_bar(0, m->calcs, m->calcs);
+    }
+
+    if (log_line) {
+        log_print(0, m->calcs, m->calcs);
+    }
 
+    if (sb && m->knn > 0)
+        knn_merge(m, sb, nt);
+    else if (sb)
+        pairs_merge(m, sb, nt);
+    sbuf_free(sb, nt);
+    sched_free(sc);
+
+    hmatrix_sync(m);
+}
 
 
 /**
@@ -572,9 +1992,28 @@ void hmatrix_destroy(hmatrix_t *m)
     if (!m)
         return;
 
-    if (m->values)
+    if (m->fd >= 0) {
+        hmatrix_sync(m);
+        if (m->values)
+            munmap((char *) m->values - MMAP_HEADER,
+                   MMAP_HEADER + m->size * hmatrix_type_size(m->type));
+        close(m->fd);
+    } else if (m->values) {
         free(m->values);
-    for (int i = 0; m->srcs && i < m->num; i++)
+    }
+
+    free(m->dups);
+    free(m->cmap);
+    free(m->rmap);
+
+    if (m->sparse) {
+        free(m->sparse->ptr);
+        free(m->sparse->cols);
+        free(m->sparse->vals);
+        free(m->sparse);
+    }
+
+    for (long i = 0; m->srcs && i < m->num; i++)
         if (m->srcs[i])
             free(m->srcs[i]);
 
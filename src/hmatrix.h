@@ -19,12 +19,53 @@
  */
 typedef struct
 {
-    int start;    /**< Start of range (inclusive) */
-    int end;      /**< End of range (exclusive) */
+    long start;   /**< Start of range (inclusive) */
+    long end;     /**< End of range (exclusive) */
 } range_t;
 
 #define RANGE_LENGTH(r) (r.end -r.start)
 
+/* Storage types of similarity values */
+#define VALUE_FLOAT     0       /* 32-bit floating point */
+#define VALUE_FLOAT16   1       /* 16-bit floating point */
+#define VALUE_UINT8     2       /* 8-bit integer (255 is NaN) */
+#define VALUE_UINT16    3       /* 16-bit integer (65535 is NaN) */
+#define VALUE_FIXED     4       /* 16-bit fixed point in [0,1] */
+
+/**
+ * Sparse matrix in compressed sparse row (CSR) format
+ */
+typedef struct
+{
+    long *ptr;          /**< Offsets of rows (rows + 1) */
+    long *cols;         /**< Column indices */
+    float *vals;        /**< Similarity values */
+    long nnz;           /**< Number of stored values */
+} hsparse_t;
+
+/* Header of memory-mapped matrix files */
+#define MMAP_MAGIC      "HARRYMAT"
+#define MMAP_VERSION    1
+#define MMAP_HEADER     4096
+
+/**
+ * Header of a memory-mapped matrix. The header is padded to the size
+ * of a page and followed by the similarity values.
+ */
+typedef struct
+{
+    char magic[8];      /**< Magic string */
+    uint32_t version;   /**< Version of file format */
+    uint32_t triangular; /**< Flag for triangular storage */
+    int64_t num;        /**< Number of strings */
+    int64_t col[2];     /**< Column range */
+    int64_t row[2];     /**< Row range */
+    int64_t size;       /**< Number of values */
+    uint64_t config;    /**< Fingerprint of configuration */
+    uint64_t input;     /**< Fingerprint of strings */
+    uint32_t type;      /**< Storage type of values */
+} mmap_header_t;
+
 /**
  * Structure for a matrix
  */
@@ -32,14 +73,30 @@ typedef struct
 {
     float *labels;      /**< Labels */
     char **srcs;        /**< Sources */
-    int num;            /**< Number of strings */
+    long num;           /**< Number of strings */
 
-    float *values;      /**< Similarity values */
-    int size;           /**< Size of memory */
-    int calcs;          /**< Required calculations */
+    void *values;       /**< Similarity values */
+    int type;           /**< Storage type of values */
+    long size;          /**< Size of memory */
+    long calcs;         /**< Required calculations */
     range_t col;        /**< Column range */
     range_t row;        /**< Row range */
+    range_t block;      /**< Block of rows held in memory */
     int triangular;     /**< Flag for triangular storage */
+
+    long *dups;         /**< Previous duplicate of strings (or -1) */
+    long *cmap;         /**< First duplicate of columns */
+    long *rmap;         /**< First duplicate of rows in block */
+
+    int fd;             /**< File descriptor of mapped storage */
+    int resume;         /**< Flag for resumed computation */
+    long sync;          /**< Interval between checkpoints (seconds) */
+    double synced;      /**< Time of last checkpoint */
+
+    hsparse_t *sparse;  /**< Sparse similarity values */
+    long knn;           /**< Number of nearest neighbors */
+    double threshold;   /**< Threshold for similar pairs */
+    int descending;     /**< Flag for larger values being more similar */
 } hmatrix_t;
 
 
@@ -115,32 +172,43 @@ typedef struct
  */
 typedef struct
 {
-    unsigned int n;
+    long n;
 
-    unsigned int n_top;
-    unsigned int n_mid;
-    unsigned int n_bottom;
+    long n_top;
+    long n_mid;
+    long n_bottom;
 
-    unsigned int a;
-    int b_top;
-    int b_bottom;
-    int b_left;
-    int b_right;
+    long a;
+    long b_top;
+    long b_bottom;
+    long b_left;
+    long b_right;
 } hmatrixspec_t;
 
-hmatrix_t *hmatrix_init(hstring_t *, int);
+hmatrix_t *hmatrix_init(hstring_t *, long);
 void hmatrix_col_range(hmatrix_t *, char *);
 void hmatrix_row_range(hmatrix_t *, char *);
 void hmatrix_inferspec(const hmatrix_t *, hmatrixspec_t *);
-void hmatrix_split(hmatrix_t *, char *);
-void hmatrix_split_ex(hmatrix_t *, const int, const int);
-float *hmatrix_alloc(hmatrix_t *);
-float hmatrix_get(hmatrix_t *, int, int);
-void hmatrix_set(hmatrix_t *, int, int, float);
+void hmatrix_split(hmatrix_t *, hstring_t *, char *, int);
+void hmatrix_split_ex(hmatrix_t *, hstring_t *, int, const int, const int);
+long hmatrix_dedup(hmatrix_t *, hstring_t *);
+int hmatrix_type(const char *);
+size_t hmatrix_type_size(int);
+void hmatrix_storage(hmatrix_t *, int);
+void hmatrix_pack(int, void *, float);
+float hmatrix_unpack(int, const void *);
+void *hmatrix_alloc(hmatrix_t *);
+void *hmatrix_block(hmatrix_t *, long, long);
+void *hmatrix_mmap(hmatrix_t *, hstring_t *, char *, uint64_t, long);
+void hmatrix_sync(hmatrix_t *);
+void hmatrix_knn(hmatrix_t *, long, int);
+void hmatrix_threshold(hmatrix_t *, double, int);
+hsparse_t *hmatrix_sparse_alloc(long, long);
+float hmatrix_get(hmatrix_t *, long, long);
+void hmatrix_set(hmatrix_t *, long, long, float);
 void hmatrix_compute(hmatrix_t *, hstring_t *,
-                     double (*measure) (hstring_t, hstring_t));
+                     double (*measure) (hstring_t, hstring_t),
+                     int (*many) (hstring_t, hstring_t *, int, float *));
 void hmatrix_destroy(hmatrix_t *);
-float hmatrix_benchmark(hmatrix_t *, hstring_t *,
-                        double (*measure) (hstring_t, hstring_t), double);
 
 #endif /* HMATRIX_H */
@@ -0,0 +1,549 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+/**
+ * @defgroup merge Merging of matrices
+ * Functions for merging parts of a matrix that have been computed
+ * separately, for example, using the options --split or --row_range.
+ * The parts are read from files in raw or text format that have been
+ * written with indices or from memory-mapped matrix files. The parts
+ * need to share the same columns and cover a contiguous range of rows.
+ * Moreover, a previously computed matrix can be loaded to extend it
+ * with new strings.
+ * @author Konrad Rieck (konrad@mlsec.org)
+ * @{
+ */
+
+#include "config.h"
+#include "common.h"
+#include "util.h"
+#include "hmatrix.h"
+#include "output_raw.h"
+#include "hmerge.h"
+
+/* External variables */
+extern config_t cfg;
+
+/* End of file and error while reading rows */
+#define ROW_EOF         -1
+#define ROW_ERROR       -2
+
+/**
+ * Read a line from a part. Comment lines are returned as well.
+ * @param p Part of matrix
+ * @return line or NULL at the end of file
+ */
+static char *read_line(hpart_t *p)
+{
+    size_t len = 0;
+
+    if (!p->line) {
+        p->size = 4096;
+        p->line = malloc(p->size);
+        if (!p->line)
+            return NULL;
+    }
+
+    /* Read until the end of the line */
+    while (gzgets(p->z, p->line + len, p->size - len)) {
+        len += strlen(p->line + len);
+        if (len > 0 && p->line[len - 1] == '\n') {
+            p->line[len - 1] = '\0';
+            return p->line;
+        }
+
+        p->size *= 2;
+        p->line = realloc(p->line, p->size);
+        if (!p->line)
+            return NULL;
+    }
+
+    return len > 0 ? p->line : NULL;
+}
+
+/**
+ * Parse the column indices of a part in text format. The indices
+ * need to be contiguous.
+ * @param p Part of matrix
+ * @param str Comment line holding the indices
+ * @return true on success, false otherwise
+ */
+static int parse_cols(hpart_t *p, char *str)
+{
+    char *end;
+    long i, n;
+
+    for (n = 0;; n++) {
+        i = strtol(str, &end, 10);
+        if (end == str)
+            break;
+        if (n == 0)
+            p->col.start = i;
+        else if (i != p->col.start + n)
+            return FALSE;
+        str = end;
+    }
+
+    p->col.end = p->col.start + n;
+    return n > 0 && *str == '\0';
+}
+
+/**
+ * Read the header of a part in raw format. If no indices are stored,
+ * the part is assumed to start at the first string.
+ * @param p Part of matrix
+ * @return true on success, false otherwise
+ */
+static int open_raw(hpart_t *p)
+{
+    uint32_t hdr[5] = {0};
+    int len = sizeof(uint32_t);
+
+    if (gzread(p->z, hdr, 3 * len) != 3 * len) {
+        error("Could not read header of part '%s'", p->file);
+        return FALSE;
+    }
+    p->type = (hdr[2] & ~RAW_INDICES) >> RAW_TYPE_SHIFT;
+    if (p->type > VALUE_FIXED ||
+        (hdr[2] & RAW_SIZE_MASK) != hmatrix_type_size(p->type)) {
+        error("Unsupported matrix type in part '%s'", p->file);
+        return FALSE;
+    }
+
+    p->indices = (hdr[2] & RAW_INDICES) != 0;
+    if (p->indices && gzread(p->z, hdr + 3, 2 * len) != 2 * len) {
+        error("Could not read indices of part '%s'", p->file);
+        return FALSE;
+    }
+
+    p->col.start = hdr[3];
+    p->col.end = hdr[3] + hdr[1];
+    p->row.start = hdr[4];
+    p->row.end = hdr[4] + hdr[0];
+    return TRUE;
+}
+
+/**
+ * Read the header of a memory-mapped matrix file (see hmatrix_mmap()).
+ * @param p Part of matrix
+ * @return true on success, false otherwise
+ */
+static int open_native(hpart_t *p)
+{
+    mmap_header_t h;
+
+    if (gzread(p->z, &h, sizeof(h)) != sizeof(h) ||
+        h.version != MMAP_VERSION || gzseek(p->z, MMAP_HEADER, SEEK_SET) < 0) {
+        error("Unsupported matrix file '%s'", p->file);
+        return FALSE;
+    }
+
+    p->indices = TRUE;
+    p->triangular = h.triangular;
+    p->type = h.type;
+    p->col.start = h.col[0];
+    p->col.end = h.col[1];
+    p->row.start = h.row[0];
+    p->row.end = h.row[1];
+    return TRUE;
+}
+
+/**
+ * Read the header of a part in text format. Parts without indices
+ * cannot be read, as the number of rows is unknown.
+ * @param p Part of matrix
+ * @return true on success, false otherwise
+ */
+static int open_text(hpart_t *p)
+{
+    char *line;
+
+    /* Skip version and look for the column indices */
+    read_line(p);
+    line = read_line(p);
+    if (!line || line[0] != '#' || !parse_cols(p, line + 1)) {
+        error("Part '%s' has no indices (see --save_indices)", p->file);
+        return FALSE;
+    }
+
+    p->indices = TRUE;
+    return TRUE;
+}
+
+/**
+ * Open a part and read its header. The format of the part is
+ * determined from the first bytes.
+ * @param p Part of matrix
+ * @return true on success, false otherwise
+ */
+int hmerge_open(hpart_t *p)
+{
+    char buf[sizeof(MMAP_MAGIC) - 1];
+    int ret;
+
+    p->z = gzopen(p->file, "r");
+    if (!p->z) {
+        error("Could not open part '%s'", p->file);
+        return FALSE;
+    }
+
+    /* Text files start with a comment */
+    memset(buf, 0, sizeof(buf));
+    gzread(p->z, buf, sizeof(buf));
+    gzrewind(p->z);
+
+    if (!memcmp(buf, MMAP_MAGIC, sizeof(buf))) {
+        p->format = PART_NATIVE;
+        ret = open_native(p);
+    } else if (!strncmp(buf, "# ", 2)) {
+        p->format = PART_TEXT;
+        ret = open_text(p);
+    } else {
+        p->format = PART_RAW;
+        ret = open_raw(p);
+    }
+
+    p->next = p->row.start;
+    return ret;
+}
+
+/**
+ * Read the next row from a part. Values that are not stored in a
+ * triangular part are set to NaN.
+ * @param p Part of matrix
+ * @param v Array for the values of the row or NULL
+ * @return index of row, ROW_EOF or ROW_ERROR
+ */
+static long read_row(hpart_t *p, float *v)
+{
+    long n = p->col.end - p->col.start, i = 0, k, r, len;
+    const char *sep;
+    char *str, *end, *idx;
+
+    if (p->format != PART_TEXT) {
+        if (p->next >= p->row.end)
+            return ROW_EOF;
+
+        /* Triangles only hold values from the diagonal on */
+        if (p->triangular)
+            for (i = 0; i < p->next - p->row.start; i++)
+                v[i] = NAN;
+
+        len = hmatrix_type_size(p->type);
+        if (gzread(p->z, v + i, (n - i) * len) != (n - i) * len) {
+            error("Could not read row %ld from part '%s'", p->next, p->file);
+            return ROW_ERROR;
+        }
+
+        /* Unpack values backwards, as they are not larger than floats */
+        for (k = n - i - 1; p->type != VALUE_FLOAT && k >= 0; k--)
+            v[i + k] = hmatrix_unpack(p->type, (char *) (v + i) + k * len);
+        return p->next++;
+    }
+
+    /* Skip comments and empty lines */
+    do {
+        str = read_line(p);
+    } while (str && (str[0] == '#' || str[0] == '\0'));
+    if (!str)
+        return ROW_EOF;
+
+    idx = strstr(str, " #");
+    if (!idx || sscanf(idx + 2, "%ld", &r) != 1) {
+        error("Row without index in part '%s'", p->file);
+        return ROW_ERROR;
+    }
+    *idx = '\0';
+
+    config_lookup_string(&cfg, "output.separator", &sep);
+    for (i = 0; i < n; i++) {
+        float f = strtof(str, &end);
+        if (end == str)
+            break;
+        if (v)
+            v[i] = f;
+        str = end + strspn(end, sep);
+    }
+
+    if (i != n || *str != '\0') {
+        error("Invalid row %ld in part '%s'", r, p->file);
+        return ROW_ERROR;
+    }
+
+    return r;
+}
+
+/**
+ * Close an open part
+ * @param p Part of matrix
+ */
+void hmerge_close(hpart_t *p)
+{
+    if (p->z)
+        gzclose(p->z);
+    p->z = NULL;
+}
+
+/**
+ * Compare two parts by their first row
+ * @param x First part
+ * @param y Second part
+ * @return comparison result
+ */
+static int part_cmp(const void *x, const void *y)
+{
+    hpart_t *a = (hpart_t *) x, *b = (hpart_t *) y;
+    return (a->row.start > b->row.start) - (a->row.start < b->row.start);
+}
+
+/**
+ * Determine the range of rows of a part. Parts in text format are
+ * read completely without storing the values.
+ * @param p Part of matrix
+ * @return true on success, false otherwise
+ */
+static int scan_part(hpart_t *p)
+{
+    long r = ROW_EOF;
+
+    p->row.start = p->row.end = -1;
+    if (!hmerge_open(p))
+        return FALSE;
+
+    if (!p->indices) {
+        error("Part '%s' has no indices (see --save_indices)", p->file);
+        return FALSE;
+    }
+    if (p->triangular) {
+        error("Triangular matrix '%s' cannot be merged", p->file);
+        return FALSE;
+    }
+
+    for (; p->format == PART_TEXT && (r = read_row(p, NULL)) >= 0;
+         p->row.end++) {
+        if (p->row.start < 0)
+            p->row.start = p->row.end = r;
+        if (r != p->row.end) {
+            error("Rows of part '%s' are not contiguous", p->file);
+            return FALSE;
+        }
+    }
+
+    if (p->format == PART_TEXT && (r == ROW_ERROR || p->row.start < 0)) {
+        if (r != ROW_ERROR)
+            error("Part '%s' contains no rows", p->file);
+        return FALSE;
+    }
+
+    hmerge_close(p);
+    return TRUE;
+}
+
+/**
+ * Scan parts of a matrix and order them by their rows. The parts need
+ * to share the same columns and cover a contiguous range of rows.
+ * @param files Array of file names
+ * @param n Number of files
+ * @return array of parts or NULL on error
+ */
+hpart_t *hmerge_scan(char **files, int n)
+{
+    hpart_t *p = calloc(n, sizeof(hpart_t));
+    int i;
+
+    if (!p) {
+        error("Could not allocate parts of matrix");
+        return NULL;
+    }
+
+    for (i = 0; i < n; i++) {
+        p[i].file = files[i];
+        info_msg(1, "Scanning part '%0.40s'.", files[i]);
+        if (!scan_part(p + i))
+            goto err;
+    }
+
+    qsort(p, n, sizeof(hpart_t), part_cmp);
+
+    for (i = 1; i < n; i++) {
+        if (p[i].col.start != p[0].col.start || p[i].col.end != p[0].col.end) {
+            error("Columns of parts '%s' and '%s' differ", p[0].file,
+                  p[i].file);
+            goto err;
+        }
+        if (p[i].row.start < p[i - 1].row.end) {
+            error("Rows of parts '%s' and '%s' overlap", p[i - 1].file,
+                  p[i].file);
+            goto err;
+        }
+        if (p[i].row.start > p[i - 1].row.end) {
+            error("Rows %ld to %ld are missing", p[i - 1].row.end,
+                  p[i].row.start - 1);
+            goto err;
+        }
+    }
+
+    return p;
+
+  err:
+    hmerge_destroy(p, n);
+    return NULL;
+}
+
+/**
+ * Initialize a matrix for merging ordered parts. The matrix spans the
+ * columns of the parts and the union of their rows.
+ * @param p Array of parts
+ * @param n Number of parts
+ * @return matrix object or NULL on error
+ */
+hmatrix_t *hmerge_init(hpart_t *p, int n)
+{
+    hmatrixspec_t spec;
+    hmatrix_t *m;
+
+    m = hmatrix_init(NULL, MAX(p[0].col.end, p[n - 1].row.end));
+    if (!m)
+        return NULL;
+
+    m->col = p[0].col;
+    m->row.start = p[0].row.start;
+    m->row.end = p[n - 1].row.end;
+    m->block = m->row;
+
+    /* Report layout of merged matrix */
+    hmatrix_inferspec(m, &spec);
+    info_msg(1, "Merging %d parts with %ld rows and %ld unique values.",
+             n, RANGE_LENGTH(m->row), spec.n);
+
+    return m;
+}
+
+/**
+ * Read the block of rows held in a matrix from a part. The blocks of
+ * a part need to be read in ascending order.
+ * @param p Part of matrix
+ * @param m Matrix object
+ * @return true on success, false otherwise
+ */
+int hmerge_read(hpart_t *p, hmatrix_t *m)
+{
+    long cl = m->col.end - m->col.start, r, i, j;
+    size_t size = hmatrix_type_size(m->type);
+    float *v;
+
+    assert(m->block.start == p->next && m->block.end <= p->row.end);
+
+    v = malloc(cl * sizeof(float));
+    if (!v) {
+        error("Could not allocate row of matrix");
+        return FALSE;
+    }
+
+    for (i = m->block.start; i < m->block.end; i++) {
+        r = read_row(p, v);
+        if (r != i) {
+            if (r >= 0)
+                error("Expected row %ld in part '%s'", i, p->file);
+            free(v);
+            return FALSE;
+        }
+
+        /* A triangle only holds values above the diagonal */
+        for (j = 0; j < cl; j++) {
+            if (!m->triangular)
+                hmatrix_pack(m->type, (char *) m->values +
+                             ((i - m->block.start) * cl + j) * size, v[j]);
+            else if (m->col.start + j >= i)
+                hmatrix_set(m, m->col.start + j, i, v[j]);
+        }
+    }
+
+    p->next = m->block.end;
+    free(v);
+    return TRUE;
+}
+
+/**
+ * Load the values of a previously computed matrix. Values outside the
+ * ranges of the matrix are ignored. Each loaded value is also set at
+ * the mirrored cell, if it lies within the ranges. Missing values are
+ * NaN and can be computed afterwards (see hmatrix_compute()).
+ * @param m Matrix object
+ * @param file File name of matrix
+ * @return number of stored values or -1 on error
+ */
+long hmerge_load(hmatrix_t *m, char *file)
+{
+    long r, j, c, cnt = -1;
+    hpart_t p;
+    float *v = NULL;
+
+    assert(m->block.start == m->row.start && m->block.end == m->row.end);
+
+    memset(&p, 0, sizeof(p));
+    p.file = file;
+    if (!hmerge_open(&p))
+        goto out;
+
+    if (p.col.start < 0 || p.col.end > m->num || p.row.end > m->num) {
+        error("Matrix '%s' does not fit the strings", file);
+        goto out;
+    }
+
+    v = malloc((p.col.end - p.col.start) * sizeof(float));
+    if (!v) {
+        error("Could not allocate row of matrix");
+        goto out;
+    }
+
+    while ((r = read_row(&p, v)) >= 0) {
+        if (r < m->row.start || r >= m->row.end)
+            continue;
+        for (j = 0; j < p.col.end - p.col.start; j++) {
+            c = p.col.start + j;
+            if (!isnan(v[j]) && c >= m->col.start && c < m->col.end)
+                hmatrix_set(m, c, r, v[j]);
+        }
+    }
+
+    /* Count stored values */
+    if (r != ROW_ERROR)
+        for (cnt = 0, j = 0; j < m->size; j++)
+            cnt += !isnan(hmatrix_unpack(m->type, (char *) m->values +
+                                         j * hmatrix_type_size(m->type)));
+
+  out:
+    hmerge_close(&p);
+    free(p.line);
+    free(v);
+    return cnt;
+}
+
+/**
+ * Destroy an array of parts
+ * @param p Array of parts
+ * @param n Number of parts
+ */
+void hmerge_destroy(hpart_t *p, int n)
+{
+    if (!p)
+        return;
+
+    for (int i = 0; i < n; i++) {
+        hmerge_close(p + i);
+        free(p[i].line);
+    }
+
+    free(p);
+}
+
+/** @} */
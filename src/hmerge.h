@@ -0,0 +1,52 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef HMERGE_H
+#define HMERGE_H
+
+#include "hmatrix.h"
+
+/* Number of values held in memory while merging */
+#define MERGE_VALUES    (1 << 24)
+
+/* Formats of parts */
+#define PART_TEXT       0       /* Text format */
+#define PART_RAW        1       /* Raw format */
+#define PART_NATIVE     2       /* Memory-mapped matrix file */
+
+/**
+ * Part of a matrix stored in a file
+ */
+typedef struct
+{
+    char *file;         /**< File name */
+    int format;         /**< Format of part */
+    int indices;        /**< Flag for stored indices */
+    int triangular;     /**< Flag for triangular storage */
+    int type;           /**< Storage type of values */
+    range_t col;        /**< Column range */
+    range_t row;        /**< Row range */
+
+    gzFile z;           /**< Open file */
+    long next;          /**< Next row to read */
+    char *line;         /**< Buffer for lines */
+    size_t size;        /**< Size of buffer */
+} hpart_t;
+
+hpart_t *hmerge_scan(char **, int);
+hmatrix_t *hmerge_init(hpart_t *, int);
+int hmerge_open(hpart_t *);
+int hmerge_read(hpart_t *, hmatrix_t *);
+void hmerge_close(hpart_t *);
+void hmerge_destroy(hpart_t *, int);
+long hmerge_load(hmatrix_t *, char *);
+
+#endif /* HMERGE_H */
@@ -0,0 +1,428 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+/**
+ * @defgroup serve Server mode
+ * Functions for serving similarity queries over a Unix domain socket.
+ * The strings of the corpus are read and preprocessed once and the value
+ * cache is kept across requests. Clients send batches of index pairs,
+ * pairs of strings or strings to compare with the whole corpus using a
+ * binary protocol (see hserve.h). Clients are served one after another,
+ * while each batch is computed using all threads.
+ * @author Konrad Rieck (konrad@mlsec.org)
+ * @{
+ */
+
+#include "config.h"
+#include "common.h"
+#include "util.h"
+#include "hserve.h"
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* External variables */
+extern int verbose;
+
+/* Flag for stopping the server */
+static volatile sig_atomic_t stop = 0;
+
+/**
+ * Signal handler for stopping the server
+ * @param sig Signal
+ */
+static void serve_stop(int sig)
+{
+    stop = 1;
+}
+
+/**
+ * Read a block of bytes from a socket
+ * @param fd Socket
+ * @param buf Buffer
+ * @param len Number of bytes
+ * @return true on success, false on error or end of stream
+ */
+static int read_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    ssize_t r;
+
+    while (len > 0) {
+        r = read(fd, p, len);
+        if (r < 0 && errno == EINTR && !stop)
+            continue;
+        if (r <= 0)
+            return FALSE;
+        p += r;
+        len -= r;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Write a block of bytes to a socket
+ * @param fd Socket
+ * @param buf Buffer
+ * @param len Number of bytes
+ * @return true on success, false on error
+ */
+static int write_full(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    ssize_t r;
+
+    while (len > 0) {
+        r = write(fd, p, len);
+        if (r < 0 && errno == EINTR && !stop)
+            continue;
+        if (r <= 0)
+            return FALSE;
+        p += r;
+        len -= r;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Send the header of a reply
+ * @param fd Socket
+ * @param status Status of request
+ * @param num Number of values
+ * @return true on success, false on error
+ */
+static int send_reply(int fd, uint32_t status, uint64_t num)
+{
+    serve_rep_t rep = { SERVE_MAGIC, status, num };
+    return write_full(fd, &rep, sizeof(rep));
+}
+
+/**
+ * Receive a string and preprocess it as the strings of the corpus
+ * @param fd Socket
+ * @param x Return pointer to string
+ * @return true on success, false on error
+ */
+static int recv_string(int fd, hstring_t *x)
+{
+    uint32_t len;
+    char *buf;
+
+    if (!read_full(fd, &len, sizeof(len)) || len > SERVE_LENGTH)
+        return FALSE;
+
+    buf = malloc(len + 1);
+    if (!buf)
+        return FALSE;
+    if (!read_full(fd, buf, len)) {
+        free(buf);
+        return FALSE;
+    }
+    buf[len] = '\0';
+
+    x->str.c = buf;
+    x->type = TYPE_BYTE;
+    x->len = len;
+    x->src = NULL;
+    x->label = 0;
+    *x = hstring_preproc(*x);
+    return TRUE;
+}
+
+/**
+ * Receive a number of strings
+ * @param fd Socket
+ * @param num Number of strings
+ * @return array of strings or NULL on error
+ */
+static hstring_t *recv_strings(int fd, long num)
+{
+    hstring_t *x = calloc(MAX(num, 1), sizeof(hstring_t));
+    long i;
+
+    if (!x)
+        return NULL;
+
+    for (i = 0; i < num; i++)
+        if (!recv_string(fd, x + i))
+            break;
+
+    if (i < num) {
+        while (i-- > 0)
+            hstring_destroy(x + i);
+        free(x);
+        return NULL;
+    }
+
+    return x;
+}
+
+/**
+ * Free received strings
+ * @param x Array of strings
+ * @param num Number of strings
+ */
+static void free_strings(hstring_t *x, long num)
+{
+    for (long i = 0; i < num; i++)
+        hstring_destroy(x + i);
+    free(x);
+}
+
+/**
+ * Answer a request with pairs of indices into the corpus
+ * @param fd Socket
+ * @param num Number of pairs
+ * @param s Array of string objects
+ * @param n Number of strings
+ * @param measure Similarity measure
+ * @return true on success, false if the connection is lost
+ */
+static int serve_pairs(int fd, long num, hstring_t *s, long n,
+                       double (*measure) (hstring_t, hstring_t))
+{
+    uint32_t *idx = malloc(MAX(num, 1) * 2 * sizeof(uint32_t));
+    float *val = malloc(MAX(num, 1) * sizeof(float));
+    int ok, valid = TRUE;
+    long i;
+
+    ok = idx && val && read_full(fd, idx, num * 2 * sizeof(uint32_t));
+    if (!ok) {
+        free(idx);
+        free(val);
+        return FALSE;
+    }
+
+    for (i = 0; i < 2 * num; i++)
+        if (idx[i] >= n)
+            valid = FALSE;
+
+    if (!valid) {
+        ok = send_reply(fd, SERVE_EINVAL, 0);
+        goto out;
+    }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+    for (i = 0; i < num; i++)
+        val[i] = measure(s[idx[2 * i]], s[idx[2 * i + 1]]);
+
+    ok = send_reply(fd, SERVE_OK, num) &&
+        write_full(fd, val, num * sizeof(float));
+
+  out:
+    free(idx);
+    free(val);
+    return ok;
+}
+
+/**
+ * Answer a request with pairs of strings
+ * @param fd Socket
+ * @param num Number of pairs
+ * @param measure Similarity measure
+ * @return true on success, false if the connection is lost
+ */
+static int serve_strings(int fd, long num,
+                         double (*measure) (hstring_t, hstring_t))
+{
+    hstring_t *x = recv_strings(fd, 2 * num);
+    float *val;
+    int ok;
+    long i;
+
+    if (!x)
+        return FALSE;
+
+    val = malloc(MAX(num, 1) * sizeof(float));
+    if (!val) {
+        free_strings(x, 2 * num);
+        return send_reply(fd, SERVE_ENOMEM, 0);
+    }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+    for (i = 0; i < num; i++)
+        val[i] = measure(x[2 * i], x[2 * i + 1]);
+
+    ok = send_reply(fd, SERVE_OK, num) &&
+        write_full(fd, val, num * sizeof(float));
+
+    free_strings(x, 2 * num);
+    free(val);
+    return ok;
+}
+
+/**
+ * Answer a request with strings compared to the whole corpus. The values
+ * are sent row by row as soon as they are computed.
+ * @param fd Socket
+ * @param num Number of strings
+ * @param s Array of string objects
+ * @param n Number of strings
+ * @param measure Similarity measure
+ * @return true on success, false if the connection is lost
+ */
+static int serve_rows(int fd, long num, hstring_t *s, long n,
+                      double (*measure) (hstring_t, hstring_t))
+{
+    hstring_t *x = recv_strings(fd, num);
+    float *val;
+    int ok;
+    long i, j;
+
+    if (!x)
+        return FALSE;
+
+    val = malloc(MAX(n, 1) * sizeof(float));
+    if (!val) {
+        free_strings(x, num);
+        return send_reply(fd, SERVE_ENOMEM, 0);
+    }
+
+    ok = send_reply(fd, SERVE_OK, num * n);
+    for (i = 0; ok && i < num; i++) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+        for (j = 0; j < n; j++)
+            val[j] = measure(s[j], x[i]);
+        ok = write_full(fd, val, n * sizeof(float));
+    }
+
+    free_strings(x, num);
+    free(val);
+    return ok;
+}
+
+/**
+ * Serve the requests of a client until it disconnects
+ * @param fd Socket of client
+ * @param s Array of string objects
+ * @param n Number of strings
+ * @param measure Similarity measure
+ * @return number of answered requests
+ */
+static long serve_client(int fd, hstring_t *s, long n,
+                         double (*measure) (hstring_t, hstring_t))
+{
+    serve_req_t req;
+    long cnt = 0;
+    int ok;
+
+    while (!stop && read_full(fd, &req, sizeof(req))) {
+        if (req.magic != SERVE_MAGIC || req.num > SERVE_ITEMS) {
+            send_reply(fd, SERVE_EINVAL, 0);
+            break;
+        }
+
+        switch (req.type) {
+        case SERVE_INFO:
+            ok = send_reply(fd, SERVE_OK, n);
+            break;
+        case SERVE_PAIRS:
+            ok = serve_pairs(fd, req.num, s, n, measure);
+            break;
+        case SERVE_STRINGS:
+            ok = serve_strings(fd, req.num, measure);
+            break;
+        case SERVE_ROWS:
+            ok = serve_rows(fd, req.num, s, n, measure);
+            break;
+        default:
+            send_reply(fd, SERVE_EINVAL, 0);
+            ok = FALSE;
+            break;
+        }
+
+        if (!ok)
+            break;
+        cnt++;
+    }
+
+    return cnt;
+}
+
+/**
+ * Serve similarity queries on a Unix domain socket until the server is
+ * interrupted. A stale socket at the same path is replaced.
+ * @param path Path of socket
+ * @param s Array of string objects (corpus)
+ * @param n Number of strings
+ * @param measure Similarity measure
+ * @return true on success, false on error
+ */
+int hserve_run(const char *path, hstring_t *s, long n,
+               double (*measure) (hstring_t, hstring_t))
+{
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    struct stat st;
+    int sfd, cfd;
+    long cnt;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        error("Path of socket '%s' is too long", path);
+        return FALSE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+
+    sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sfd < 0 || bind(sfd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(sfd, 16) < 0) {
+        error("Could not listen on socket '%s'", path);
+        if (sfd >= 0)
+            close(sfd);
+        return FALSE;
+    }
+
+    /* Stop on interrupt and ignore lost connections */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = serve_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    info_msg(1, "Serving %ld strings on socket '%0.40s'.", n, path);
+    while (!stop) {
+        cfd = accept(sfd, NULL, NULL);
+        if (cfd < 0 && errno == EINTR)
+            continue;
+        if (cfd < 0) {
+            error("Could not accept connection");
+            break;
+        }
+
+        cnt = serve_client(cfd, s, n, measure);
+        info_msg(2, "Answered %ld requests of client.", cnt);
+        close(cfd);
+    }
+
+    info_msg(1, "Stopping server.");
+    close(sfd);
+    unlink(path);
+    return TRUE;
+}
+
+/** @} */
@@ -0,0 +1,60 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef HSERVE_H
+#define HSERVE_H
+
+#include "hstring.h"
+
+/* Magic number of requests and replies ("HRRY") */
+#define SERVE_MAGIC     0x59525248
+
+/* Limits of requests */
+#define SERVE_ITEMS     (1 << 24)
+#define SERVE_LENGTH    (1 << 28)
+
+/* Types of requests */
+#define SERVE_INFO      0       /* Number of strings in corpus */
+#define SERVE_PAIRS     1       /* Pairs of indices into corpus */
+#define SERVE_STRINGS   2       /* Pairs of strings */
+#define SERVE_ROWS      3       /* Strings compared with corpus */
+
+/* Status of replies */
+#define SERVE_OK        0
+#define SERVE_EINVAL    1       /* Invalid request */
+#define SERVE_ENOMEM    2       /* Out of memory */
+
+/**
+ * Header of a request. It is followed by the items of the request in
+ * host byte order. Indices are given as uint32_t and strings as their
+ * length (uint32_t) followed by the bytes.
+ */
+typedef struct
+{
+    uint32_t magic;     /**< Magic number */
+    uint32_t type;      /**< Type of request */
+    uint32_t num;       /**< Number of items */
+} serve_req_t;
+
+/**
+ * Header of a reply. It is followed by the values as float.
+ */
+typedef struct
+{
+    uint32_t magic;     /**< Magic number */
+    uint32_t status;    /**< Status of request */
+    uint64_t num;       /**< Number of values */
+} serve_rep_t;
+
+int hserve_run(const char *, hstring_t *, long,
+               double (*measure) (hstring_t, hstring_t));
+
+#endif /* HSERVE_H */
@@ -0,0 +1,464 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+/**
+ * @defgroup library Library
+ * Interface for computing similarity values in-process. A handle holds a
+ * configuration that is set up using the same parameters as the tool.
+ * Strings are passed as arrays of byte buffers, which are compared in
+ * place if no preprocessing is configured, and the values are written to
+ * a matrix provided by the caller. Handles are independent, yet the
+ * similarity measures share global state. Calls are therefore serialized
+ * and the configuration of a handle is activated when it is used, while
+ * each computation runs with the configured number of threads.
+ * @author Konrad Rieck (konrad@mlsec.org)
+ * @{
+ */
+
+#include "config.h"
+#include "common.h"
+#include "harry.h"
+#include "hconfig.h"
+#include "util.h"
+#include "hstring.h"
+#include "measures.h"
+#include "vcache.h"
+#include "libharry.h"
+
+/* Global variables of the library */
+int verbose = 0;
+int log_line = 0;
+config_t cfg;
+
+/**
+ * Handle of the library
+ */
+struct harry
+{
+    long id;            /**< Identifier of handle */
+    long stamp;         /**< Number of changes */
+    config_t cfg;       /**< Configuration of handle */
+    char **keys;        /**< Changed settings */
+    char **vals;        /**< Values of changed settings */
+    int num;            /**< Number of changed settings */
+};
+
+/* Settings that do not apply to the library */
+static char *unsupported[] = {
+    "input.input_format", "input.chunk_size", "measures.col_range",
+    "measures.row_range", "measures.split", "measures.row_block",
+    "measures.mmap_file", "measures.mmap_sync", "measures.extend_file",
+    "measures.knn", "measures.threshold", "measures.filter",
+    "measures.storage", "measures.dedup", "measures.index_file",
+    "measures.graph_links", "measures.graph_build", "measures.graph_search",
+    "measures.graph_recall", NULL
+};
+
+/* State of the active configuration */
+static long active_id = -1;
+static long active_stamp = -1;
+static int active_copy = FALSE;
+static int active_threads = 1;
+static long handles = 0;
+
+/**
+ * Set a configuration setting from a string. The string is converted to
+ * the type of the setting.
+ * @param c Configuration
+ * @param path Path of setting
+ * @param value Value as string
+ * @return true on success, false otherwise
+ */
+static int setting_set(config_t *c, const char *path, const char *value)
+{
+    config_setting_t *cs = config_lookup(c, path);
+    char *end;
+    long l;
+    double d;
+
+    if (!cs)
+        return FALSE;
+
+    switch (config_setting_type(cs)) {
+    case CONFIG_TYPE_STRING:
+        return config_setting_set_string(cs, value);
+    case CONFIG_TYPE_INT:
+        l = strtol(value, &end, 10);
+        if (end == value || *end != '\0')
+            return FALSE;
+        return config_setting_set_int(cs, l);
+    case CONFIG_TYPE_FLOAT:
+        d = strtod(value, &end);
+        if (end == value || *end != '\0')
+            return FALSE;
+        return config_setting_set_float(cs, d);
+    case CONFIG_TYPE_BOOL:
+        if (!strcasecmp(value, "true") || !strcmp(value, "1"))
+            return config_setting_set_bool(cs, CONFIG_TRUE);
+        if (!strcasecmp(value, "false") || !strcmp(value, "0"))
+            return config_setting_set_bool(cs, CONFIG_FALSE);
+        return FALSE;
+    default:
+        return FALSE;
+    }
+}
+
+/**
+ * Determine the path of a setting. Besides full paths, the names of
+ * settings of the configured measure, the measures and the input are
+ * accepted, such as "norm", "granularity" or "reverse_str".
+ * @param h Handle
+ * @param key Name or path of setting
+ * @param path Buffer for path
+ * @param len Length of buffer
+ * @return true on success, false otherwise
+ */
+static int setting_path(harry_t *h, const char *key, char *path, int len)
+{
+    config_setting_t *cs;
+    const char *m;
+
+    config_lookup_string(&h->cfg, "measures.measure", &m);
+
+    for (int i = 0; i < 4; i++) {
+        switch (i) {
+        case 0:
+            snprintf(path, len, "%s", key);
+            break;
+        case 1:
+            snprintf(path, len, "measures.%s.%s", m, key);
+            break;
+        case 2:
+            snprintf(path, len, "measures.%s", key);
+            break;
+        case 3:
+            snprintf(path, len, "input.%s", key);
+            break;
+        }
+
+        cs = config_lookup(&h->cfg, path);
+        if (cs && config_setting_type(cs) != CONFIG_TYPE_GROUP)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Create a handle
+ * @param measure Name of similarity measure or NULL for default
+ * @return handle or NULL on error
+ */
+harry_t *harry_new(const char *measure)
+{
+    harry_t *h = calloc(1, sizeof(harry_t));
+    if (!h) {
+        error("Could not allocate handle");
+        return NULL;
+    }
+
+#ifdef HAVE_OPENMP
+#pragma omp critical (libharry)
+#endif
+    h->id = handles++;
+
+    config_init(&h->cfg);
+    config_check(&h->cfg);
+
+    if (measure && harry_set(h, "measures.measure", measure) != 0) {
+        harry_free(h);
+        return NULL;
+    }
+
+    return h;
+}
+
+/**
+ * Change a setting of a handle. The value is converted to the type of
+ * the setting. Settings that do not apply to a single matrix computed
+ * in-process, such as ranges or sparse matrices, are rejected.
+ * @param h Handle
+ * @param key Name or path of setting
+ * @param value Value as string
+ * @return 0 on success, -1 otherwise
+ */
+int harry_set(harry_t *h, const char *key, const char *value)
+{
+    char path[256], **k, **v;
+    int i;
+
+    if (!setting_path(h, key, path, sizeof(path))) {
+        error("Unknown setting '%s'", key);
+        return -1;
+    }
+
+    for (i = 0; unsupported[i]; i++)
+        if (!strcmp(path, unsupported[i]))
+            return -1;
+
+    if (!setting_set(&h->cfg, path, value)) {
+        error("Invalid value '%s' for setting '%s'", value, path);
+        return -1;
+    }
+
+    /* Replace or add setting */
+    for (i = 0; i < h->num; i++)
+        if (!strcmp(h->keys[i], path))
+            break;
+
+    if (i == h->num) {
+        k = realloc(h->keys, (h->num + 1) * sizeof(char *));
+        if (k)
+            h->keys = k;
+        v = realloc(h->vals, (h->num + 1) * sizeof(char *));
+        if (v)
+            h->vals = v;
+        if (!k || !v) {
+            error("Could not allocate settings");
+            return -1;
+        }
+        h->keys[i] = strdup(path);
+        h->vals[i] = NULL;
+        h->num++;
+    }
+
+    free(h->vals[i]);
+    h->vals[i] = strdup(value);
+    h->stamp++;
+    return 0;
+}
+
+/**
+ * Activate the configuration of a handle. The value cache is cleared if
+ * the configuration changes.
+ * @param h Handle
+ * @return true on success, false otherwise
+ */
+static int harry_activate(harry_t *h)
+{
+    const char *str;
+    cfg_int threads;
+    int decode, reverse, soundex;
+
+    if (h->id == active_id && h->stamp == active_stamp)
+        return TRUE;
+
+    if (active_id >= 0) {
+        vcache_destroy();
+        stoptokens_destroy();
+        config_destroy(&cfg);
+    }
+
+    config_init(&cfg);
+    config_check(&cfg);
+    for (int i = 0; i < h->num; i++)
+        setting_set(&cfg, h->keys[i], h->vals[i]);
+
+    active_id = h->id;
+    active_stamp = h->stamp;
+    vcache_init();
+
+    if (!config_check(&cfg)) {
+        active_stamp = -1;
+        return FALSE;
+    }
+
+    config_lookup_string(&cfg, "input.stoptoken_file", &str);
+    if (strlen(str) > 0)
+        stoptokens_load(str);
+
+    config_lookup_string(&cfg, "measures.measure", &str);
+    measure_config(str);
+
+    /* Strings are compared in place unless they are preprocessed */
+    config_lookup_bool(&cfg, "input.decode_str", &decode);
+    config_lookup_bool(&cfg, "input.reverse_str", &reverse);
+    config_lookup_bool(&cfg, "input.soundex", &soundex);
+    config_lookup_string(&cfg, "measures.granularity", &str);
+    active_copy = decode || reverse || soundex || strcasecmp(str, "bytes");
+    config_lookup_string(&cfg, "input.stoptoken_file", &str);
+    active_copy |= strlen(str) > 0;
+
+    config_lookup_int(&cfg, "measures.num_threads", &threads);
+#ifdef HAVE_OPENMP
+    active_threads = threads > 0 ? threads : omp_get_num_procs();
+#else
+    active_threads = 1;
+#endif
+
+    return TRUE;
+}
+
+/**
+ * Convert byte buffers to string objects. The buffers are referenced
+ * without copying unless the strings are preprocessed.
+ * @param s Array of string objects
+ * @param x Array of buffers
+ * @param len Lengths of buffers
+ * @param n Number of buffers
+ * @return true on success, false otherwise
+ */
+static int strings_init(hstring_t *s, const char *const *x,
+                        const size_t *len, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (len[i] > INT_MAX) {
+            error("String %zu is too long", i);
+            return FALSE;
+        }
+
+        s[i].type = TYPE_BYTE;
+        s[i].len = len[i];
+        s[i].src = NULL;
+        s[i].label = 0;
+
+        if (!active_copy) {
+            s[i].str.c = (char *) x[i];
+            continue;
+        }
+
+        s[i].str.c = malloc(len[i] + 1);
+        if (!s[i].str.c) {
+            error("Could not allocate string");
+            return FALSE;
+        }
+        memcpy(s[i].str.c, x[i], len[i]);
+        s[i].str.c[len[i]] = '\0';
+        s[i] = hstring_preproc(s[i]);
+    }
+
+    return TRUE;
+}
+
+/**
+ * Free string objects created from byte buffers
+ * @param s Array of string objects
+ * @param n Number of strings
+ */
+static void strings_free(hstring_t *s, size_t n)
+{
+    if (!s)
+        return;
+
+    for (size_t i = 0; active_copy && i < n; i++)
+        if (s[i].str.c)
+            hstring_destroy(s + i);
+    free(s);
+}
+
+/**
+ * Compute a matrix of similarity values with the active configuration
+ * @param x Array of buffers (rows)
+ * @param xlen Lengths of buffers
+ * @param nx Number of buffers
+ * @param y Array of buffers (columns) or NULL
+ * @param ylen Lengths of buffers
+ * @param ny Number of buffers
+ * @param out Matrix of nx x ny values (row-major)
+ * @return true on success, false otherwise
+ */
+static int harry_compute(const char *const *x, const size_t *xlen,
+                         size_t nx, const char *const *y,
+                         const size_t *ylen, size_t ny, float *out)
+{
+    hstring_t *xs, *ys = NULL;
+    long i, j, sym = (y == NULL);
+    float *o;
+    int ok;
+
+    xs = calloc(MAX(nx, 1), sizeof(hstring_t));
+    if (!sym)
+        ys = calloc(MAX(ny, 1), sizeof(hstring_t));
+
+    ok = xs && (sym || ys) && strings_init(xs, x, xlen, nx) &&
+        (sym || strings_init(ys, y, ylen, ny));
+    if (!ok) {
+        strings_free(xs, nx);
+        strings_free(ys, ny);
+        return FALSE;
+    }
+
+    /* Compute in the same order as the tool */
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 4) num_threads(active_threads) \
+    private(j, o)
+#endif
+    for (i = 0; i < (long) nx; i++) {
+        if (sym) {
+            o = out + i * nx;
+            if (!measure_compare_many(xs[i], xs + i, nx - i, o + i))
+                for (j = i; j < (long) nx; j++)
+                    out[i * nx + j] = measure_compare(xs[i], xs[j]);
+            for (j = i + 1; j < (long) nx; j++)
+                out[j * nx + i] = out[i * nx + j];
+        } else {
+            if (!measure_compare_many(xs[i], ys, ny, out + i * ny))
+                for (j = 0; j < (long) ny; j++)
+                    out[i * ny + j] = measure_compare(ys[j], xs[i]);
+        }
+    }
+
+    strings_free(xs, nx);
+    strings_free(ys, ny);
+    return TRUE;
+}
+
+/**
+ * Compare strings given as byte buffers. If y is NULL, the strings of x
+ * are compared with each other and ny is ignored. The values are written
+ * to a matrix of nx rows and ny (or nx) columns in row-major order.
+ * @param h Handle
+ * @param x Array of buffers (rows)
+ * @param xlen Lengths of buffers
+ * @param nx Number of buffers
+ * @param y Array of buffers (columns) or NULL
+ * @param ylen Lengths of buffers
+ * @param ny Number of buffers
+ * @param out Matrix of values
+ * @return 0 on success, -1 otherwise
+ */
+int harry_compare(harry_t *h, const char *const *x, const size_t *xlen,
+                  size_t nx, const char *const *y, const size_t *ylen,
+                  size_t ny, float *out)
+{
+    int ok = FALSE;
+
+#ifdef HAVE_OPENMP
+#pragma omp critical (libharry)
+#endif
+    {
+        if (harry_activate(h))
+            ok = harry_compute(x, xlen, nx, y, ylen, ny, out);
+    }
+
+    return ok ? 0 : -1;
+}
+
+/**
+ * Destroy a handle
+ * @param h Handle
+ */
+void harry_free(harry_t *h)
+{
+    if (!h)
+        return;
+
+    for (int i = 0; i < h->num; i++) {
+        free(h->keys[i]);
+        free(h->vals[i]);
+    }
+    free(h->keys);
+    free(h->vals);
+    config_destroy(&h->cfg);
+    free(h);
+}
+
+/** @} */
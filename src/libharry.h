@@ -0,0 +1,36 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef LIBHARRY_H
+#define LIBHARRY_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Handle of the library. Each handle holds its own configuration.
+ */
+typedef struct harry harry_t;
+
+harry_t *harry_new(const char *);
+int harry_set(harry_t *, const char *, const char *);
+int harry_compare(harry_t *, const char *const *, const size_t *, size_t,
+                  const char *const *, const size_t *, size_t, float *);
+void harry_free(harry_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBHARRY_H */
@@ -0,0 +1,384 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+#include "config.h"
+#include "common.h"
+#include "util.h"
+#include "peq.h"
+#include "align.h"
+
+/**
+ * @addtogroup measures
+ * <hr>
+ * <em>align</em>: Vectorized dynamic programming for edit distances with
+ * weighted costs.
+ *
+ * The measures store integers in their matrices, such that each edit
+ * operation adds the integer part of its cost. The kernels compute the
+ * same matrices using vectors of 32-bit cells. The cells of an
+ * anti-diagonal do not depend on each other and are computed at once for
+ * the Levenshtein and the OSA distance. For the Damerau-Levenshtein
+ * distance, the measure looks up the transpositions of a row and the
+ * kernel computes the row, where insertions are resolved by a prefix
+ * minimum within the vectors. Bands of bounded distances are reproduced
+ * exactly, such that the kernels return the same distances as the
+ * measures.
+ * @{
+ */
+
+/* Codes of padding symbols differing from all symbols */
+#define PAD_X           -2
+#define PAD_Y           -3
+
+/* Scratch memory of a thread */
+typedef struct
+{
+    int *x;             /**< Codes of first string */
+    int *y;             /**< Codes of second string */
+    int *mem;           /**< Cells of anti-diagonals */
+    size_t cap_x;       /**< Capacity of first codes */
+    size_t cap_y;       /**< Capacity of second codes */
+    size_t cap_mem;     /**< Capacity of cells */
+} scratch_t;
+
+static scratch_t scratch = { 0 };
+#ifdef HAVE_OPENMP
+#pragma omp threadprivate(scratch)
+#endif
+
+#ifdef ENABLE_SIMD
+
+/* Number of cells in a vector */
+#define VEC_NUM         8
+
+/* Vector of cells, possibly unaligned */
+typedef int32_t vec_t __attribute__ ((vector_size(4 * VEC_NUM),
+                                      aligned(4), may_alias));
+
+#define VEC_LOAD(p)     (*(const vec_t *) (p))
+#define VEC_STORE(p, v) (*(vec_t *) (p) = (v))
+
+/* Minimum of two vectors (evaluates arguments twice) */
+#define VEC_MIN(a, b)   (((a) & ((a) < (b))) | ((b) & ((a) >= (b))))
+
+#ifdef HAVE_TARGET_CLONES
+#define KERNEL __attribute__ ((target_clones("avx2", "sse4.1", "default")))
+#else
+#define KERNEL
+#endif
+
+/**
+ * Computes the interior cells of an anti-diagonal. The cell (i, k - i) is
+ * stored at index i of the anti-diagonal k.
+ * @param x codes of first string (code of x[i - 1] at i)
+ * @param y reversed codes of second string (code of y[k - i - 1] at i)
+ * @param dg anti-diagonals k, k - 1, k - 2, k - 3 and k - 4
+ * @param lo first row of cells
+ * @param hi last row of cells
+ * @param c costs of insertion, deletion, substitution and transposition
+ * @param tra enable transpositions
+ * @return minimum of computed cells
+ */
+KERNEL static int kernel_edit(const int *x, const int *y, int **dg, int lo,
+                              int hi, const int *c, int tra)
+{
+    vec_t zero = { 0 }, idx = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    vec_t ins = zero + c[0], del = zero + c[1], sub = zero + c[2];
+    vec_t trc = zero + c[3], inf = zero + ALIGN_INF, lim = zero + hi;
+    vec_t mv = inf, a, b, ne, in;
+    const int *d1 = dg[1], *d2 = dg[2], *d4 = dg[4];
+    int i, min = ALIGN_INF, *d0 = dg[0];
+
+    for (i = lo; i <= hi; i += VEC_NUM) {
+        ne = VEC_LOAD(x + i) != VEC_LOAD(y + i);
+
+        /* Insertion, deletion and substitution */
+        a = VEC_LOAD(d1 + i - 1) + ins;
+        b = VEC_LOAD(d1 + i) + del;
+        a = VEC_MIN(a, b);
+        b = VEC_LOAD(d2 + i - 1) + (sub & ne);
+        a = VEC_MIN(a, b);
+
+        /* Transposition */
+        if (tra) {
+            in = (VEC_LOAD(x + i) == VEC_LOAD(y + i + 1)) &
+                (VEC_LOAD(x + i - 1) == VEC_LOAD(y + i));
+            b = VEC_LOAD(d4 + i - 2) + (trc & ne);
+            b = VEC_MIN(a, b);
+            a = (b & in) | (a & ~in);
+        }
+
+        VEC_STORE(d0 + i, a);
+
+        /* Minimum of cells up to the last row */
+        in = (idx + i) <= lim;
+        b = (a & in) | (inf & ~in);
+        mv = VEC_MIN(mv, b);
+    }
+
+    for (i = 0; i < VEC_NUM; i++)
+        min = MIN(min, mv[i]);
+
+    return min;
+}
+
+/**
+ * Computes the cells of a row for the Damerau-Levenshtein distance
+ * @param xi code of the symbol of the row
+ * @param y codes of second string
+ * @param prev previous row
+ * @param cur current row
+ * @param t transpositions of the cells without costs
+ * @param jl first column
+ * @param jh last column
+ * @param c costs of insertion, deletion, substitution and transposition
+ */
+KERNEL static void kernel_damerau(int xi, const int *y, const int *prev,
+                                  int *cur, const int *t, int jl, int jh,
+                                  const int *c)
+{
+    vec_t zero = { 0 }, idx = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    vec_t s1 = { 8, 0, 1, 2, 3, 4, 5, 6 }, s2 = { 8, 9, 0, 1, 2, 3, 4, 5 };
+    vec_t s4 = { 8, 9, 10, 11, 0, 1, 2, 3 }, inf = zero + ALIGN_INF;
+    vec_t ins = zero + c[0], del = zero + c[1], sub = zero + c[2];
+    vec_t tra = zero + c[3], sym = zero + xi, run = idx * ins, left = zero + cur[jl], a, b;
+    int j;
+
+    for (j = jl; j <= jh; j += VEC_NUM) {
+        /* Substitution, deletion and transposition */
+        a = VEC_LOAD(prev + j) + (sub & (VEC_LOAD(y + j - 1) != sym));
+        b = VEC_LOAD(prev + j + 1) + del;
+        a = VEC_MIN(a, b);
+        b = VEC_LOAD(t + j) + tra;
+        a = VEC_MIN(a, b);
+
+        /* Insertions as prefix minimum */
+        b = __builtin_shuffle(a, inf, s1) + ins;
+        a = VEC_MIN(a, b);
+        b = __builtin_shuffle(a, inf, s2) + 2 * ins;
+        a = VEC_MIN(a, b);
+        b = __builtin_shuffle(a, inf, s4) + 4 * ins;
+        a = VEC_MIN(a, b);
+        b = left + run;
+        a = VEC_MIN(a, b);
+
+        VEC_STORE(cur + j + 1, a);
+        left = zero + a[VEC_NUM - 1];
+    }
+}
+
+#endif
+
+/**
+ * Encodes the symbols of two strings as integers for the current thread.
+ * Bytes and bits are kept, while tokens are mapped to the slots of a
+ * pattern-equality table, where tokens missing in the first string are
+ * encoded as -1. The codes of x start at
+ * index 1 and are preceded and followed by padding symbols. The codes of
+ * y are followed by padding symbols.
+ * @param x first string
+ * @param y second string
+ * @param rev reverse the second string
+ * @param a returned codes of first string
+ * @param b returned codes of second string
+ * @return number of codes or 0 on error
+ */
+int align_encode(hstring_t x, hstring_t y, int rev, int **a, int **b)
+{
+    peq_t *p = NULL;
+    int i, size = 256;
+
+    if (!mem_reserve((void **) &scratch.x, &scratch.cap_x,
+                     x.len + 1 + ALIGN_PAD, sizeof(int)) ||
+        !mem_reserve((void **) &scratch.y, &scratch.cap_y,
+                     y.len + 1 + ALIGN_PAD, sizeof(int))) {
+        error("Failed to allocate memory for codes of symbols");
+        return 0;
+    }
+
+    if (x.type == TYPE_TOKEN) {
+        p = peq_index(x);
+        if (!p)
+            return 0;
+        size = 1 << (64 - p->shift);
+    }
+
+    *a = scratch.x;
+    *b = scratch.y;
+
+    (*a)[0] = PAD_X;
+    for (i = 0; i < x.len; i++)
+        (*a)[i + 1] = p ? peq_slot(p, x.str.s[i]) :
+            (uint8_t) hstring_get(x, i);
+    for (i = x.len + 1; i < x.len + 1 + ALIGN_PAD; i++)
+        (*a)[i] = PAD_X;
+
+    for (i = 0; i < y.len; i++)
+        (*b)[rev ? y.len - 1 - i : i] = p ? peq_slot(p, y.str.s[i]) :
+            (uint8_t) hstring_get(y, i);
+    for (i = y.len; i < y.len + 1 + ALIGN_PAD; i++)
+        (*b)[i] = PAD_Y;
+
+    if (p)
+        peq_clear(p, x);
+    return size;
+}
+
+/**
+ * Converts the costs of edit operations to integers. The measures add
+ * the integer part of a cost to their cells, which are rounded once the
+ * fractional part gets close to one, so such costs are not supported.
+ * @param c costs
+ * @param num number of costs
+ * @param out integer costs
+ * @return true if supported, false otherwise
+ */
+int align_costs(const double *c, int num, int *out)
+{
+    int i;
+
+    for (i = 0; i < num; i++) {
+        if (!(c[i] >= 0 && c[i] < ALIGN_MAX) || c[i] - floor(c[i]) > 0.9)
+            return FALSE;
+        out[i] = (int) c[i];
+    }
+
+    return TRUE;
+}
+
+/**
+ * Checks whether two strings can be compared in vectors, such that the
+ * cells stay within the supported range
+ * @param x first string
+ * @param y second string
+ * @param c integer costs
+ * @param mc cost of margin cells
+ * @return true if supported, false otherwise
+ */
+int align_check(hstring_t x, hstring_t y, const int *c, double mc)
+{
+#ifdef ENABLE_SIMD
+    double cmax = MAX(MAX(c[0], c[1]), MAX(c[2], c[3]));
+
+    if (x.type != y.type)
+        return FALSE;
+
+    return (x.len + y.len + 2.0) * (MAX(cmax, mc) + 3) < ALIGN_MAX;
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * Computes the Levenshtein or OSA distance with integer costs along
+ * anti-diagonals. Cells within the band of width w are computed, cells
+ * next to the band are infinite. The computation is stopped if all cells
+ * of four consecutive anti-diagonals exceed the bound, as no edit
+ * operation skips more anti-diagonals.
+ * @param x first string
+ * @param y second string
+ * @param c costs of insertion, deletion, substitution and transposition
+ * @param tra enable transpositions
+ * @param mc cost of margin cells
+ * @param mw number of finite margin cells of the first row
+ * @param w width of band
+ * @param bound bound of distance or 0
+ * @param d returned distance or ALIGN_INF if larger than bound
+ * @return true if computed, false if not supported
+ */
+int align_edit(hstring_t x, hstring_t y, const int *c, int tra, double mc,
+               int mw, int w, double bound, int *d)
+{
+#ifdef ENABLE_SIMD
+    int i, k, lo, hi, min, run = 0, *xs, *ys, *t, *dg[5];
+    int n = x.len, m = y.len, len = n + 1 + ALIGN_PAD;
+
+    if (!align_check(x, y, c, mc) || !align_encode(x, y, TRUE, &xs, &ys))
+        return FALSE;
+    if (!mem_reserve((void **) &scratch.mem, &scratch.cap_mem, 5 * len,
+                     sizeof(int))) {
+        error("Failed to allocate memory for anti-diagonals");
+        return FALSE;
+    }
+
+    for (i = 0; i < 5; i++)
+        dg[i] = scratch.mem + i * len + 2;
+
+    for (k = 0; k <= n + m; k++) {
+        t = dg[4];
+        dg[4] = dg[3];
+        dg[3] = dg[2];
+        dg[2] = dg[1];
+        dg[1] = dg[0];
+        dg[0] = t;
+
+        /* Rows of interior cells within the band */
+        lo = MAX(MAX(1, k - m), (k - w + 1) / 2);
+        hi = MIN(MIN(n, k - 1), (k + w) / 2);
+
+        min = ALIGN_INF;
+        if (lo <= hi)
+            min = kernel_edit(xs, ys + m - k, dg, lo, hi, c, tra);
+
+        /* Cells next to the band and margins */
+        if (lo > 1 && lo <= n + 1 && k - lo + 1 <= m)
+            dg[0][lo - 1] = ALIGN_INF;
+        if (hi < n && k - hi > 1)
+            dg[0][hi + 1] = ALIGN_INF;
+        if (k <= m) {
+            dg[0][0] = k <= mw ? (int) (k * mc) : ALIGN_INF;
+            min = MIN(min, dg[0][0]);
+        }
+        if (k <= n) {
+            dg[0][k] = (int) (k * mc);
+            min = MIN(min, dg[0][k]);
+        }
+
+        run = bound > 0 && min > bound ? run + 1 : 0;
+        if (run == 4) {
+            *d = ALIGN_INF;
+            return TRUE;
+        }
+    }
+
+    *d = dg[0][n];
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * Computes a row of the Damerau-Levenshtein distance with integer costs.
+ * The rows are laid out as in the measure, where the first two cells hold
+ * the first column. Cells up to ALIGN_PAD after the last column may be
+ * overwritten.
+ * @param xi code of the symbol of the row
+ * @param y codes of second string
+ * @param prev previous row
+ * @param cur current row
+ * @param t transpositions of the cells without costs
+ * @param jl first column
+ * @param jh last column
+ * @param c costs of insertion, deletion, substitution and transposition
+ * @return true if computed, false if not supported
+ */
+int align_damerau(int xi, const int *y, const int *prev, int *cur,
+                  const int *t, int jl, int jh, const int *c)
+{
+#ifdef ENABLE_SIMD
+    kernel_damerau(xi, y, prev, cur, t, jl, jh, c);
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/** @} */
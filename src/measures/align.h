@@ -0,0 +1,34 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef ALIGN_H
+#define ALIGN_H
+
+#include "hstring.h"
+
+/* Value of cells outside the band (same as in the measures) */
+#define ALIGN_INF       (INT_MAX / 4)
+
+/* Maximum value of cells within the band */
+#define ALIGN_MAX       (1 << 20)
+
+/* Padding of arrays for loading full vectors */
+#define ALIGN_PAD       16
+
+int align_encode(hstring_t, hstring_t, int, int **, int **);
+int align_costs(const double *, int, int *);
+int align_check(hstring_t, hstring_t, const int *, double);
+int align_edit(hstring_t, hstring_t, const int *, int, double, int, int,
+               double, int *);
+int align_damerau(int, const int *, const int *, int *, const int *, int,
+                  int, const int *);
+
+#endif /* ALIGN_H */
@@ -14,6 +14,7 @@
 #include "harry.h"
 #include "util.h"
 #include "norm.h"
+#include "align.h"
 #include "dist_damerau.h"
 
 /**
@@ -32,17 +33,28 @@ static double cost_ins = 1.0;
 static double cost_del = 1.0;
 static double cost_sub = 1.0;
 static double cost_tra = 1.0;
+static double max_dist = 0.0;
 
 /* External variables */
 extern config_t cfg;
 
-/* Symbols hash table */
+/* Scratch memory of a thread */
 typedef struct
 {
-    sym_t sym;          /**< Symbol (key) */
-    int val;            /**< Value associated with symbol */
-    UT_hash_handle hh;  /**< Makes struct hashable */
-} sym_hash_t;
+    int *mem;           /**< Rows of matrix */
+    int **rows;         /**< Rows before last occurrences of symbols */
+    int *last;          /**< Last occurrences of symbols in x */
+    uint8_t *shared;    /**< Symbols occurring in y */
+    size_t cap_mem;     /**< Capacity of rows */
+    size_t cap_rows;    /**< Capacity of row pointers */
+    size_t cap_last;    /**< Capacity of last occurrences */
+    size_t cap_shared;  /**< Capacity of shared symbols */
+} scratch_t;
+
+static scratch_t scratch = { 0 };
+#ifdef HAVE_OPENMP
+#pragma omp threadprivate(scratch)
+#endif
 
 /*
  * Four-way minimum
@@ -52,63 +64,6 @@ static float min(float a, float b, float c, float d)
     return fmin(fmin(a, b), fmin(c, d));
 }
 
-/**
- * Get value associated with a symbol from the hash
- * @param hash hash table
- * @param s symbol
- * @return value
- */
-static int hash_get(sym_hash_t **hash, sym_t s)
-{
-    sym_hash_t *entry = NULL;
-
-    HASH_FIND(hh, *hash, &s, sizeof(sym_t), entry);
-    if (!entry) {
-        entry = malloc(sizeof(sym_hash_t));
-        entry->sym = s;
-        entry->val = 0;
-        HASH_ADD(hh, *hash, sym, sizeof(sym_t), entry);
-    }
-
-    return entry->val;
-}
-
-/**
- * Set the value of a symbol in the hash
- * @param hash hash table
- * @param s symbol
- * @param val value
- */
-static void hash_set(sym_hash_t **hash, sym_t s, int val)
-{
-    sym_hash_t *entry = NULL;
-
-    HASH_FIND(hh, *hash, &s, sizeof(sym_t), entry);
-    if (!entry) {
-        entry = malloc(sizeof(sym_hash_t));
-        entry->sym = s;
-        entry->val = val;
-        HASH_ADD(hh, *hash, sym, sizeof(sym_t), entry);
-    }
-
-    entry->val = val;
-}
-
-/**
- * Destroy hash table
- * @param hash hash table
- */
-static void hash_destroy(sym_hash_t **hash)
-{
-    sym_hash_t *entry;
-
-    while (*hash) {
-        entry = *hash;
-        HASH_DEL(*hash, entry);
-        free(entry);
-    }
-}
-
 /**
  * Initializes the similarity measure
  */
@@ -121,72 +76,166 @@ void dist_damerau_config()
     config_lookup_float(&cfg, "measures.dist_damerau.cost_del", &cost_del);
     config_lookup_float(&cfg, "measures.dist_damerau.cost_sub", &cost_sub);
     config_lookup_float(&cfg, "measures.dist_damerau.cost_tra", &cost_tra);
+    config_lookup_float(&cfg, "measures.dist_damerau.max_dist", &max_dist);
 
     /* Normalization */
     config_lookup_string(&cfg, "measures.dist_damerau.norm", &str);
     n = lnorm_get(str);
 }
 
-/* Ugly macros to access arrays */
-#define D(i,j)       d[(i) * (y.len + 2) + (j)]
+/* Value of cells outside the band of a bounded distance */
+#define BAND_INF     (INT_MAX / 4)
 
 /**
  * Computes the Damerau-Levenshtein distance of two strings. Adapted from 
- * Wikipedia entry and comments from Stackoverflow.com
+ * Wikipedia entry and comments from Stackoverflow.com. If the distance
+ * is bounded, only a diagonal band of the matrix is computed. Rows are
+ * not abandoned early, as transpositions may skip over rows.
+ *
+ * A transposition only refers to the row before the last occurrence of
+ * a symbol in x. Hence, only these rows are kept for the symbols occurring
+ * in both strings, such that the memory is linear in the length of y for
+ * bytes. The last occurrences are stored in arrays indexed by the codes
+ * of the symbols. Costs with small fractional parts are computed using
+ * SIMD instructions.
  * @param x first string 
  * @param y second string
- * @return Levenshtein distance
+ * @return Levenshtein distance or infinity if larger than bound
  */
 float dist_damerau_compare(hstring_t x, hstring_t y)
 {
-    sym_hash_t *shash = NULL;
-    int i, j, inf = x.len + y.len;
+    int i, j, i1, j1, db, dz, w, jl, jh, xi, size, num, vec, c[4];
+    int inf = x.len + y.len, stride = y.len + 2 + ALIGN_PAD;
+    int cmin = MIN(1, floor(MIN(cost_ins, cost_del))), sub = cost_sub;
+    int *xs, *ys, *row, *prev, *cur, *next, *t, *u, **rows, *last;
+    double cs[4] = { cost_ins, cost_del, cost_sub, cost_tra };
+    uint8_t *shared;
+    float r;
 
     if (x.len == 0 && y.len == 0)
         return 0;
 
-    /* Allocate table for dynamic programming */
-    int *d = malloc((x.len + 2) * (y.len + 2) * sizeof(int));
-    if (!d) {
+    /* Width of band left and right of the diagonal */
+    w = MAX(x.len, y.len);
+    if (max_dist > 0) {
+        if (abs(x.len - y.len) * cmin > max_dist)
+            return INFINITY;
+        if (cmin > 0)
+            w = MIN(floor(max_dist / cmin), w);
+    }
+
+    /* Codes of symbols and symbols occurring in both strings */
+    size = align_encode(x, y, FALSE, &xs, &ys);
+    if (!size ||
+        !mem_reserve((void **) &scratch.rows, &scratch.cap_rows, size + 1,
+                     sizeof(int *)) ||
+        !mem_reserve((void **) &scratch.last, &scratch.cap_last, size + 1,
+                     sizeof(int)) ||
+        !mem_reserve((void **) &scratch.shared, &scratch.cap_shared, size,
+                     1)) {
         error("Could not allocate memory for Damerau-Levenshtein distance");
         return 0;
     }
 
-    /* Initialize distance matrix */
-    D(0, 0) = inf;
-    for (i = 0; i <= x.len; i++) {
-        D(i + 1, 1) = i;
-        D(i + 1, 0) = inf;
+    /* Symbols of y missing in x have the code -1 */
+    rows = scratch.rows + 1;
+    last = scratch.last + 1;
+    shared = scratch.shared;
+    memset(last - 1, 0, (size + 1) * sizeof(int));
+    memset(shared, 0, size);
+
+    for (num = 0, j = 0; j < y.len; j++) {
+        if (ys[j] >= 0 && !shared[ys[j]]) {
+            shared[ys[j]] = TRUE;
+            num++;
+        }
     }
-    for (j = 0; j <= y.len; j++) {
-        D(1, j + 1) = j;
-        D(0, j + 1) = inf;
+
+    /* Rows of shared symbols, first row, two rows and transpositions */
+    if (!mem_reserve((void **) &scratch.mem, &scratch.cap_mem,
+                     (num + 4) * (size_t) stride, sizeof(int))) {
+        error("Could not allocate memory for Damerau-Levenshtein distance");
+        return 0;
     }
+    row = scratch.mem;
+    prev = row + stride;
+    cur = prev + stride;
+    t = cur + stride;
+    next = t + stride;
+    for (j = -1; j < size; j++)
+        rows[j] = row;
+
+    /* Initialize first rows of distance matrix */
+    for (j = 0; j <= y.len + 1; j++)
+        row[j] = inf;
+    prev[0] = inf;
+    for (j = 0; j <= y.len; j++)
+        prev[j + 1] = j;
+
+    vec = align_costs(cs, 4, c) && align_check(x, y, c, 1);
 
     for (i = 1; i <= x.len; i++) {
-        int db = 0;
-        for (j = 1; j <= y.len; j++) {
-            int i1 = hash_get(&shash, hstring_get(y, j - 1));
-            int j1 = db;
-            int dz = hstring_compare(x, i - 1, y, j - 1) ? cost_sub : 0;
+        xi = xs[i];
+        jl = MAX(1, i - w);
+        jh = MIN(y.len, i + w);
+        cur[0] = inf;
+        cur[1] = i;
+        if (jl > 1)
+            cur[jl] = BAND_INF;
+
+        /* Earlier matches within the row are not visited outside the band */
+        for (db = 0, j = 1; j < jl; j++)
+            if (!(xi != ys[j - 1] ? sub : 0))
+                db = j;
+
+        for (j = jl; j <= jh; j++) {
+            i1 = last[ys[j - 1]];
+            j1 = db;
+            dz = xi != ys[j - 1] ? sub : 0;
             if (dz == 0)
                 db = j;
 
-            D(i + 1, j + 1) = min(D(i, j) + dz,
-                                  D(i + 1, j) + cost_ins,
-                                  D(i, j + 1) + cost_del,
-                                  D(i1, j1) + (i - i1 - 1) + cost_tra +
-                                  (j - j1 - 1));
+            /* Transposed cells outside the band exceed the bound */
+            if (i1 > 0 && j1 > 0 && abs(i1 - j1) > w)
+                t[j] = BAND_INF;
+            else
+                t[j] = rows[ys[j - 1]][j1];
+
+            if (vec) {
+                t[j] += (i - i1 - 1) + (j - j1 - 1);
+                continue;
+            }
+
+            r = t[j];
+            cur[j + 1] = min(prev[j] + dz, cur[j] + cost_ins,
+                             prev[j + 1] + cost_del,
+                             r + (i - i1 - 1) + cost_tra + (j - j1 - 1));
         }
 
-        hash_set(&shash, hstring_get(x, i - 1), i);
+        if (vec)
+            align_damerau(xi, ys, prev, cur, t, jl, jh, c);
+        if (jh < y.len)
+            cur[jh + 2] = BAND_INF;
+
+        /* Keep the previous row for the last occurrence of the symbol */
+        last[xi] = i;
+        u = prev;
+        if (shared[xi]) {
+            u = rows[xi];
+            if (u == row) {
+                u = next;
+                next += stride;
+            }
+            rows[xi] = prev;
+        }
+        prev = cur;
+        cur = u;
     }
 
-    float r = D(x.len + 1, y.len + 1);
+    r = prev[y.len + 1];
 
-    /* Free memory */
-    free(d);
-    hash_destroy(&shash);
+    if (max_dist > 0 && r > max_dist)
+        return INFINITY;
 
     return lnorm(n, r, x, y);
 }
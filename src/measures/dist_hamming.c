@@ -13,6 +13,7 @@
 #include "harry.h"
 #include "util.h"
 #include "norm.h"
+#include "lanes.h"
 #include "dist_hamming.h"
 
 /**
@@ -67,4 +68,33 @@ float dist_hamming_compare(hstring_t x, hstring_t y)
     return lnorm(n, d, x, y);
 }
 
+/**
+ * Computes the Hamming distances of a string and several strings. Short
+ * strings of bytes are compared in SIMD lanes.
+ * @param x first string
+ * @param y array of strings
+ * @param num number of strings
+ * @param out array of distances
+ * @return true if the distances are computed, false otherwise
+ */
+int dist_hamming_compare_many(hstring_t x, hstring_t *y, int num,
+                              float *out)
+{
+    int i, j, c, d[LANES_NUM];
+
+    for (i = 0; i < num; i += LANES_NUM) {
+        c = MIN(num - i, LANES_NUM);
+        if (!lanes_hamming(x, y + i, c, d)) {
+            for (j = 0; j < c; j++)
+                out[i + j] = dist_hamming_compare(x, y[i + j]);
+            continue;
+        }
+
+        for (j = 0; j < c; j++)
+            out[i + j] = lnorm(n, d[j], x, y[i + j]);
+    }
+
+    return TRUE;
+}
+
 /** @} */
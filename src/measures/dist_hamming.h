@@ -17,5 +17,6 @@
 /* Module interface */
 void dist_hamming_config();
 float dist_hamming_compare(hstring_t, hstring_t);
+int dist_hamming_compare_many(hstring_t, hstring_t *, int, float *);
 
 #endif /* DIST_HAMMING_H */
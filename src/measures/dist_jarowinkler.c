@@ -22,6 +22,7 @@
 #include "common.h"
 #include "harry.h"
 #include "util.h"
+#include "peq.h"
 
 #include "dist_jarowinkler.h"
 
@@ -37,6 +38,11 @@
  * Winkler.  String Comparator Metrics and Enhanced Decision Rules in the
  * Fellegi-Sunter Model of Record Linkage. Proceedings of the Section on
  * Survey Research Methods. 354-359, 1990.
+ *
+ * Strings of up to 64 symbols are compared bit-parallel: the positions
+ * of each symbol in the shorter string are kept as bit mask, such that
+ * the first unassigned match within the window is found using a single
+ * word operation.
  * @{
  */
 
@@ -46,6 +52,9 @@ extern config_t cfg;
 /* Global variables */
 static double scaling = 0.1;
 
+/* Maximum length of strings compared bit-parallel */
+#define JARO_BITS       64
+
 #ifdef JARO_COMPARE_SERRANO
 /* Some help functions */
 static inline int max(int x, int y)
@@ -135,6 +144,65 @@ static float dist_jaro_compare_serrano(hstring_t x, hstring_t y)
                  ((float) (m - t) / m)) / 3.0);
 }
 #else
+/**
+ * Computes the Jaro distance from the number of matches and
+ * transpositions
+ * @param match number of matching symbols
+ * @param trans number of transposed symbols
+ * @param n length of shorter string
+ * @param m length of longer string
+ * @return Jaro distance
+ */
+static float jaro(int match, int trans, int n, int m)
+{
+    float md = (float) match;
+    return 1.0 - (md / n + md / m + 1.0 - trans / md / 2.0) / 3.0;
+}
+
+/**
+ * Computes the Jaro distance of two strings bit-parallel. Each symbol of
+ * y is assigned to the first unassigned position of the same symbol in x
+ * within the window, which is the lowest bit of a single mask. Symbols
+ * assigned out of order are counted as transpositions by walking the
+ * assigned positions of x in order.
+ * @param p pattern-equality table of x with one word
+ * @param x shorter string
+ * @param y longer string with at most 64 symbols
+ * @return Jaro distance
+ */
+static float dist_jaro_compare_bits(const peq_t *p, hstring_t x,
+                                    hstring_t y)
+{
+    uint64_t used = 0, win, cand;
+    int i, j, k, trans = 0, match = 0, halflen = (x.len + 1) / 2;
+    uint8_t pos[JARO_BITS];
+
+    for (i = 0; i < MIN(y.len, x.len + halflen); i++) {
+        /* Window of positions from i - halflen to i + halflen */
+        win = ~0ULL << MAX(0, i - halflen);
+        if (i + halflen < 63)
+            win &= (2ULL << (i + halflen)) - 1;
+
+        cand = *peq_get(p, y, i) & ~used & win;
+        if (!cand)
+            continue;
+
+        j = __builtin_ctzll(cand);
+        used |= 1ULL << j;
+        pos[match++] = j;
+    }
+
+    if (!match)
+        return 1.0;
+
+    for (k = 0; k < match; k++) {
+        trans += pos[k] != __builtin_ctzll(used);
+        used &= used - 1;
+    }
+
+    return jaro(match, trans, x.len, y.len);
+}
+
 /**
  * Computes the Jaro distance of two strings. Code adapted from
  * from implementation by David Necas (Yeti).
@@ -146,7 +214,8 @@ static float dist_jaro_compare_yeti(hstring_t x, hstring_t y)
 {
     int i, j, halflen, trans, match, to;
     int *idx;
-    float md;
+    peq_t *p;
+    float d;
 
     if (x.len == 0 || y.len == 0) {
         if (x.len == 0 && y.len == 0)
@@ -161,6 +230,13 @@ static float dist_jaro_compare_yeti(hstring_t x, hstring_t y)
         y = z;
     }
 
+    /* Short strings of bytes and tokens are compared bit-parallel */
+    if (y.len <= JARO_BITS && x.type != TYPE_BIT && (p = peq_build(x))) {
+        d = dist_jaro_compare_bits(p, x, y);
+        peq_clear(p, x);
+        return d;
+    }
+
     halflen = (x.len + 1) / 2;
     idx = (int *) calloc(x.len, sizeof(int));
     if (!idx) {
@@ -178,7 +254,7 @@ static float dist_jaro_compare_yeti(hstring_t x, hstring_t y)
     match = 0;
     /* the part with allowed range overlapping left */
     for (i = 0; i < halflen; i++) {
-        for (j = 0; j <= i + halflen; j++) {
+        for (j = 0; j <= i + halflen && j < x.len; j++) {
             if (!hstring_compare(x, j, y, i) && !idx[j]) {
                 match++;
                 idx[j] = match;
@@ -214,8 +290,7 @@ static float dist_jaro_compare_yeti(hstring_t x, hstring_t y)
     }
     free(idx);
 
-    md = (float) match;
-    return 1.0 - (md / x.len + md / y.len + 1.0 - trans / md / 2.0) / 3.0;
+    return jaro(match, trans, x.len, y.len);
 }
 #endif
 
@@ -235,15 +310,49 @@ float dist_jaro_compare(hstring_t x, hstring_t y)
 }
 
 /**
- * Computes the Jaro-Winkler distance of two strings.
+ * Computes the Jaro distances of a string and several strings. The
+ * pattern-equality table of x is built once and shared by all strings
+ * that are at least as long as x and have at most 64 symbols.
+ * @param x first string
+ * @param y array of strings
+ * @param num number of strings
+ * @param out array of distances
+ * @return true on success, false otherwise
+ */
+int dist_jaro_compare_many(hstring_t x, hstring_t *y, int num, float *out)
+{
+    peq_t *p = NULL;
+    int i;
+
+#ifndef JARO_COMPARE_SERRANO
+    if (x.len > 0 && x.len <= JARO_BITS && x.type != TYPE_BIT)
+        p = peq_build(x);
+
+    for (i = 0; p && i < num; i++)
+        if (y[i].len >= x.len && y[i].len <= JARO_BITS)
+            out[i] = dist_jaro_compare_bits(p, x, y[i]);
+    if (p)
+        peq_clear(p, x);
+#endif
+
+    /* Remaining strings are compared one by one */
+    for (i = 0; i < num; i++)
+        if (!p || y[i].len < x.len || y[i].len > JARO_BITS)
+            out[i] = dist_jaro_compare(x, y[i]);
+
+    return TRUE;
+}
+
+/**
+ * Adjusts the Jaro distance of two strings by their common prefix.
+ * @param d Jaro distance
  * @param x first string
  * @param y second string
  * @return Jaro-Winkler distance
  */
-float dist_jarowinkler_compare(hstring_t x, hstring_t y)
+static float winkler(float d, hstring_t x, hstring_t y)
 {
     int l;
-    float d = dist_jaro_compare(x, y);
 
     /* Calculate common string prefix up to 4 chars */
     int m = min(min(x.len, y.len), 4);
@@ -255,4 +364,35 @@ float dist_jarowinkler_compare(hstring_t x, hstring_t y)
     return d - l * scaling * d;
 }
 
+/**
+ * Computes the Jaro-Winkler distance of two strings.
+ * @param x first string
+ * @param y second string
+ * @return Jaro-Winkler distance
+ */
+float dist_jarowinkler_compare(hstring_t x, hstring_t y)
+{
+    return winkler(dist_jaro_compare(x, y), x, y);
+}
+
+/**
+ * Computes the Jaro-Winkler distances of a string and several strings.
+ * @param x first string
+ * @param y array of strings
+ * @param num number of strings
+ * @param out array of distances
+ * @return true on success, false otherwise
+ */
+int dist_jarowinkler_compare_many(hstring_t x, hstring_t *y, int num,
+                                  float *out)
+{
+    int i;
+
+    dist_jaro_compare_many(x, y, num, out);
+    for (i = 0; i < num; i++)
+        out[i] = winkler(out[i], x, y[i]);
+
+    return TRUE;
+}
+
 /** @} */
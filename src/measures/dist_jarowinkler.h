@@ -17,10 +17,12 @@
 /* Interface 1 */
 void dist_jarowinkler_config();
 float dist_jarowinkler_compare(hstring_t, hstring_t);
+int dist_jarowinkler_compare_many(hstring_t, hstring_t *, int, float *);
 
 /* Interface 2 */
 #define dist_jaro_config dist_jarowinkler_config
 float dist_jaro_compare(hstring_t, hstring_t);
+int dist_jaro_compare_many(hstring_t, hstring_t *, int, float *);
 
 
 #endif /* DIST_JAROWINKLER_H */
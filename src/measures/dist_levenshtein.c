@@ -15,6 +15,9 @@
 #include "harry.h"
 #include "util.h"
 #include "norm.h"
+#include "peq.h"
+#include "lanes.h"
+#include "align.h"
 #include "dist_levenshtein.h"
 
 /**
@@ -24,14 +27,24 @@
  *
  * Levenshtein. Binary codes capable of correcting deletions, insertions,
  * and reversals. Doklady Akademii Nauk SSSR, 163 (4):845-848, 1966.
+ *
+ * Myers. A fast bit-vector algorithm for approximate string matching
+ * based on dynamic programming. Journal of the ACM, 46(3):395-415, 1999.
  * @{
  */
 
+/* Minimum number of tokens for bit-parallel comparison */
+#define MYERS_TOKENS    8
+
+/* Maximum length of strings compared in lanes instead of bit-parallel */
+#define LANES_CUTOFF    24
+
 /* Normalizations */
 static lnorm_t n = LN_NONE;
 static double cost_ins = 1.0;
 static double cost_del = 1.0;
 static double cost_sub = 1.0;
+static double max_dist = 0.0;
 
 /* External variables */
 extern config_t cfg;
@@ -50,6 +63,8 @@ void dist_levenshtein_config()
                         &cost_del);
     config_lookup_float(&cfg, "measures.dist_levenshtein.cost_sub",
                         &cost_sub);
+    config_lookup_float(&cfg, "measures.dist_levenshtein.max_dist",
+                        &max_dist);
 
     /* Normalization */
     config_lookup_string(&cfg, "measures.dist_levenshtein.norm", &str);
@@ -169,24 +184,206 @@ static float dist_levenshtein_compare_yeti(hstring_t x, hstring_t y)
     return i;
 }
 
+/**
+ * Removes the common prefix and suffix of two strings. Both do not
+ * change the Levenshtein distance with unit costs.
+ * @param x first string
+ * @param y second string
+ */
+static void trim_affixes(hstring_t *x, hstring_t *y)
+{
+    int i = 0, j;
+
+    while (i < x->len && i < y->len && !hstring_compare(*x, i, *y, i))
+        i++;
+    for (j = 0; j < x->len - i && j < y->len - i; j++)
+        if (hstring_compare(*x, x->len - j - 1, *y, y->len - j - 1))
+            break;
+
+    if (x->type == TYPE_BYTE) {
+        x->str.c += i;
+        y->str.c += i;
+    } else {
+        x->str.s += i;
+        y->str.s += i;
+    }
+    x->len -= i + j;
+    y->len -= i + j;
+}
+
+/**
+ * Computes the Levenshtein distance with unit costs using the bit-vector
+ * algorithm by Myers in the formulation by Hyyrö (2003). The shorter
+ * string is encoded as pattern-equality table and each column of the
+ * matrix is updated as bit vector of vertical differences. Patterns of
+ * up to 64 symbols use a single word, longer patterns are split into
+ * blocks of words that pass the horizontal difference on. If the
+ * distance is bounded, only the words intersecting the diagonal band of
+ * the bound are updated (Ukkonen, 1985). Words below the band are added
+ * with increasing differences, words above the band pass an increasing
+ * difference on. Values outside the band thus only grow, while values
+ * within the bound are exact. The computation is stopped early if the
+ * last row exceeds the bound by more than the remaining columns.
+ * @param x first string (bytes or tokens)
+ * @param y second string (bytes or tokens)
+ * @param k bound of distance or -1
+ * @return Levenshtein distance, a value larger than k or -1 on error
+ */
+static int dist_levenshtein_compare_myers(hstring_t x, hstring_t y, int k)
+{
+    uint64_t eq, xv, xh, ph, mh, pv, mv, *pvs, *mvs, last, hb;
+    const uint64_t *e;
+    int i, j, d, hin, hout, neg, lo, hi, band;
+    peq_t *p;
+
+    trim_affixes(&x, &y);
+
+    /* Use the shorter string as pattern */
+    if (x.len > y.len) {
+        hstring_t z = x;
+        x = y;
+        y = z;
+    }
+    if (x.len == 0 || (k >= 0 && y.len - x.len > k))
+        return y.len;
+
+    p = peq_build(x);
+    if (!p)
+        return -1;
+
+    d = x.len;
+    last = 1ULL << ((x.len - 1) % 64);
+
+    if (p->words == 1) {
+        pv = ~0ULL;
+        mv = 0;
+        for (j = 0; j < y.len; j++) {
+            eq = *peq_get(p, y, j);
+            xv = eq | mv;
+            xh = (((eq & pv) + pv) ^ pv) | eq;
+            ph = mv | ~(xh | pv);
+            mh = pv & xh;
+            d += (ph & last) != 0;
+            d -= (mh & last) != 0;
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+        }
+        peq_clear(p, x);
+        return d;
+    }
+
+    /* Without bound the band covers the whole matrix */
+    band = k < 0 ? x.len + y.len : k;
+
+    /* Value d is kept for the last row of the lowest word in the band */
+    pvs = p->state;
+    mvs = p->state + p->words;
+    pvs[0] = ~0ULL;
+    mvs[0] = 0;
+    d = 64;
+    lo = hi = 0;
+
+    for (j = 0; j < y.len; j++) {
+        /* Add words reaching the band below */
+        while (hi < p->words - 1 && 64 * (hi + 1) <= j + band) {
+            hi++;
+            pvs[hi] = ~0ULL;
+            mvs[hi] = 0;
+            d += MIN(64, x.len - 64 * hi);
+        }
+        /* Skip words leaving the band above */
+        while (lo < hi && 64 * lo + 63 < j - band)
+            lo++;
+
+        e = peq_get(p, y, j);
+        /* The first row increases by one in each column */
+        hin = 1;
+        for (i = lo; i <= hi; i++) {
+            pv = pvs[i];
+            mv = mvs[i];
+            neg = hin < 0;
+            eq = e[i];
+            xv = eq | mv;
+            eq |= neg;
+            xh = (((eq & pv) + pv) ^ pv) | eq;
+            ph = mv | ~(xh | pv);
+            mh = pv & xh;
+
+            hb = i == p->words - 1 ? last : 1ULL << 63;
+            hout = ((ph & hb) != 0) - ((mh & hb) != 0);
+
+            ph = (ph << 1) | (hin > 0);
+            mh = (mh << 1) | neg;
+            pvs[i] = mh | ~(xv | ph);
+            mvs[i] = ph & xv;
+            hin = hout;
+        }
+        d += hin;
+
+        /* The last row decreases by at most one in each column */
+        if (hi == p->words - 1 && d - (y.len - 1 - j) > band) {
+            peq_clear(p, x);
+            return band + 1;
+        }
+    }
+
+    peq_clear(p, x);
+    return d;
+}
+
+/**
+ * Computes the Levenshtein distance with unit costs. Bytes and tokens
+ * are compared bit-parallel, while bits and a few tokens, for which
+ * hashing the tokens does not pay off, use the implementation by David
+ * Necas (Yeti).
+ * @param x first string
+ * @param y second string
+ * @param k bound of distance or -1
+ * @return Levenshtein distance (larger than k if it exceeds the bound)
+ */
+static float dist_levenshtein_compare_unit(hstring_t x, hstring_t y, int k)
+{
+    int d = -1;
+
+    if (x.type == TYPE_BYTE ||
+        (x.type == TYPE_TOKEN && MIN(x.len, y.len) > MYERS_TOKENS))
+        d = dist_levenshtein_compare_myers(x, y, k);
+
+    return d < 0 ? dist_levenshtein_compare_yeti(x, y) : d;
+}
+
 /* Ugly macros to access arrays */
 #define ROWS(i,j)	rows[(i) * (y.len + 1) + (j)]
 
+/* Value of cells outside the band of a bounded distance */
+#define BAND_INF	(INT_MAX / 4)
+
 /**
  * Computes the Levenshtein distance of two strings. 
  * Adapted from Stephen Toub's C# implementation. 
  * http://blogs.msdn.com/b/toub/archive/2006/05/05/590814.aspx
+ * Costs with small fractional parts are computed along anti-diagonals
+ * using SIMD instructions.
  * @param x first string
  * @param y second string
  * @return Levenshtein distance
  */
 static float dist_levenshtein_compare_toub(hstring_t x, hstring_t y)
 {
-    int i, j, a, b;
+    int i, j, a, b, c[4];
+    double cs[4] = { cost_ins, cost_del, cost_sub, 0 };
 
     if (x.len == 0 && y.len == 0)
         return 0;
 
+    /* Same matrix computed in vectors */
+    if (align_costs(cs, 4, c) &&
+        align_edit(x, y, c, FALSE, 1, MAX(x.len, y.len), MAX(x.len, y.len),
+                   0, &a))
+        return a;
+
     /* 
      * Rather than maintain an entire matrix (which would require O(n*m)
      * space), just store the current row and the next row, each of which
@@ -248,6 +445,105 @@ static float dist_levenshtein_compare_toub(hstring_t x, hstring_t y)
 }
 
 
+/**
+ * Computes the Levenshtein distance up to a bound. Only a diagonal band
+ * of the matrix is computed, as cells outside the band exceed the bound
+ * (Ukkonen, 1985). The computation is stopped early if all cells of a
+ * row exceed the bound. Like the variant by Stephen Toub, the matrix
+ * holds integers, such that both implementations return the same
+ * distances. The band is also computed along anti-diagonals.
+ * @param x first string
+ * @param y second string
+ * @param ins cost of insertion
+ * @param del cost of deletion
+ * @param sub cost of substitution
+ * @param k bound of distance
+ * @return Levenshtein distance or infinity if larger than bound
+ */
+static float dist_levenshtein_compare_bounded(hstring_t x, hstring_t y,
+                                              double ins, double del,
+                                              double sub, double k)
+{
+    int i, j, a, b, w, jl, jh, lo, *mem, *prev, *curr, *t, c[4];
+    int cmin = MIN(1, floor(MIN(ins, del)));
+    double cs[4] = { ins, del, sub, 0 };
+
+    /* Length difference exceeds bound */
+    if (abs(x.len - y.len) * cmin > k)
+        return INFINITY;
+
+    /* Width of band left and right of the diagonal */
+    w = MAX(x.len, y.len);
+    if (cmin > 0)
+        w = MIN(floor(k / cmin), w);
+
+    /* Same band computed in vectors */
+    if (align_costs(cs, 4, c) &&
+        align_edit(x, y, c, FALSE, 1, w, w, k, &a))
+        return a > k ? INFINITY : a;
+
+    mem = malloc(2 * (y.len + 2) * sizeof(int));
+    if (!mem) {
+        error("Failed to allocate memory for Levenshtein distance");
+        return 0;
+    }
+    prev = mem;
+    curr = mem + y.len + 2;
+
+    for (j = 0; j <= MIN(y.len, w); j++)
+        prev[j] = j;
+    prev[j] = BAND_INF;
+
+    for (i = 1; i <= x.len; i++) {
+        jl = MAX(1, i - w);
+        jh = MIN(y.len, i + w);
+        curr[jl - 1] = jl == 1 ? i : BAND_INF;
+        lo = curr[jl - 1];
+
+        for (j = jl; j <= jh; j++) {
+            /* Insertion and deletion */
+            a = prev[j] + ins;
+            b = curr[j - 1] + del;
+            if (a > b)
+                a = b;
+
+            /* Substitution */
+            b = prev[j - 1] + (hstring_compare(x, i - 1, y, j - 1) ? sub : 0);
+            if (a > b)
+                a = b;
+
+            curr[j] = a;
+            if (lo > a)
+                lo = a;
+        }
+        curr[jh + 1] = BAND_INF;
+
+        /* All cells of the row exceed the bound */
+        if (lo > k) {
+            free(mem);
+            return INFINITY;
+        }
+
+        t = prev;
+        prev = curr;
+        curr = t;
+    }
+
+    a = prev[y.len];
+    free(mem);
+    return a > k ? INFINITY : a;
+}
+
+/**
+ * Checks whether the costs of all edit operations are equal
+ * @return true if costs are equal, false otherwise
+ */
+static int unit_costs(void)
+{
+    return fabs(cost_ins - cost_del) < 1e-6 &&
+        fabs(cost_del - cost_sub) < 1e-6;
+}
+
 /**
  * Computes the Levenshtein distance. Wrapper function.
  * @param x first string
@@ -256,20 +552,76 @@ static float dist_levenshtein_compare_toub(hstring_t x, hstring_t y)
  */
 float dist_levenshtein_compare(hstring_t x, hstring_t y)
 {
+    double k;
     float f;
 
     /*
-     * If the costs of all edit operations are equal we use the fast
-     * implementation by David Necas, otherwise we switch to the 
-     * variant by Stephen Toub.
+     * If the costs of all edit operations are equal we use the
+     * bit-parallel implementation, otherwise we switch to the variant by
+     * Stephen Toub. If the distance is bounded, only a band of the
+     * matrix is computed in both cases.
      */
-    if (fabs(cost_ins - cost_del) < 1e-6 && fabs(cost_del - cost_sub) < 1e-6) {
-        f = cost_ins * dist_levenshtein_compare_yeti(x, y);
+    if (unit_costs()) {
+        k = max_dist / cost_ins;
+        if (max_dist > 0 && abs(x.len - y.len) > k)
+            f = INFINITY;
+        else
+            f = dist_levenshtein_compare_unit(x, y, max_dist > 0 ?
+                                              MIN(floor(k), INT_MAX / 4) :
+                                              -1);
+        f = max_dist > 0 && f > k ? INFINITY : cost_ins * f;
     } else {
-        f = dist_levenshtein_compare_toub(x,y);
+        if (max_dist > 0)
+            f = dist_levenshtein_compare_bounded(x, y, cost_ins, cost_del,
+                                                 cost_sub, max_dist);
+        else
+            f = dist_levenshtein_compare_toub(x, y);
     }
 
     return lnorm(n, f, x, y);
 }
 
+/**
+ * Computes the Levenshtein distances of a string and several strings.
+ * Only equal costs are supported, for which the distance is symmetric.
+ * Very short strings of bytes are compared in SIMD lanes, while longer
+ * strings are compared faster one by one using the bit-parallel
+ * algorithm.
+ * @param x first string
+ * @param y array of strings
+ * @param num number of strings
+ * @param out array of distances
+ * @return true if the distances are computed, false otherwise
+ */
+int dist_levenshtein_compare_many(hstring_t x, hstring_t *y, int num,
+                                  float *out)
+{
+    int i, j, c, l, d[LANES_NUM];
+    double k = max_dist / cost_ins;
+    float f;
+
+    if (!unit_costs())
+        return FALSE;
+
+    for (i = 0; i < num; i += LANES_NUM) {
+        c = MIN(num - i, LANES_NUM);
+        for (l = x.len, j = 0; j < c; j++)
+            l = MAX(l, y[i + j].len);
+        if (l > LANES_CUTOFF || !lanes_levenshtein(x, y + i, c, d)) {
+            for (j = 0; j < c; j++)
+                out[i + j] = dist_levenshtein_compare(x, y[i + j]);
+            continue;
+        }
+
+        /* Same as the wrapper function */
+        for (j = 0; j < c; j++) {
+            f = d[j];
+            f = max_dist > 0 && f > k ? INFINITY : cost_ins * f;
+            out[i + j] = lnorm(n, f, x, y[i + j]);
+        }
+    }
+
+    return TRUE;
+}
+
 /** @} */
@@ -17,5 +17,6 @@
 /* Module interface */
 void dist_levenshtein_config();
 float dist_levenshtein_compare(hstring_t, hstring_t);
+int dist_levenshtein_compare_many(hstring_t, hstring_t *, int, float *);
 
 #endif /* DIST_LEVENSHTEIN_H */
@@ -13,6 +13,8 @@
 #include "harry.h"
 #include "util.h"
 #include "norm.h"
+#include "lanes.h"
+#include "align.h"
 #include "dist_osa.h"
 
 /**
@@ -31,10 +33,18 @@ static double cost_ins = 1.0;
 static double cost_del = 1.0;
 static double cost_sub = 1.0;
 static double cost_tra = 1.0;
+static double max_dist = 0.0;
 
 /* External variables */
 extern config_t cfg;
 
+/* Rows of matrix of the current thread */
+static int *rows = NULL;
+static size_t cap_rows = 0;
+#ifdef HAVE_OPENMP
+#pragma omp threadprivate(rows, cap_rows)
+#endif
+
 /**
  * Initializes the similarity measure
  */
@@ -47,39 +57,76 @@ void dist_osa_config()
     config_lookup_float(&cfg, "measures.dist_osa.cost_del", &cost_del);
     config_lookup_float(&cfg, "measures.dist_osa.cost_sub", &cost_sub);
     config_lookup_float(&cfg, "measures.dist_osa.cost_tra", &cost_tra);
+    config_lookup_float(&cfg, "measures.dist_osa.max_dist", &max_dist);
 
     /* Normalization */
     config_lookup_string(&cfg, "measures.dist_osa.norm", &str);
     n = lnorm_get(str);
 }
 
-/* Ugly macros to access arrays */
-#define D(i,j) 		d[(i) * (y.len + 1) + (j)]
+/* Ugly macros to access the last three rows */
+#define D(i,j) 		d[((i) % 3) * (y.len + 1) + (j)]
+
+/* Value of cells outside the band of a bounded distance */
+#define BAND_INF	(INT_MAX / 4)
 
 /**
- * Computes the OSA distance of two strings. 
+ * Computes the OSA distance of two strings. If the distance is bounded,
+ * only a diagonal band of the matrix is computed and the computation is
+ * stopped early if all cells of two consecutive rows exceed the bound.
+ * Only the last three rows of the matrix are kept. Costs with small
+ * fractional parts are computed along anti-diagonals using SIMD
+ * instructions.
  * @param x first string 
  * @param y second string
- * @return OSA distance
+ * @return OSA distance or infinity if larger than bound
  */
 float dist_osa_compare(hstring_t x, hstring_t y)
 {
-    int i, j, a, b, c;
+    int i, j, a, b, c, w, jl, jh, lo, last = 0;
+    int cmin = floor(MIN(cost_ins, cost_del)), cost[4];
+    double cs[4] = { cost_ins, cost_del, cost_sub, cost_tra };
 
     if (x.len == 0 && y.len == 0)
         return 0;
 
-    /* Allocate matrix. We might reduce this to some rows only */
-    int *d = (int *) calloc((x.len + 1) * (y.len + 1), sizeof(int));
+    /* Width of band left and right of the diagonal */
+    w = MAX(x.len, y.len);
+    if (max_dist > 0) {
+        if (abs(x.len - y.len) * cmin > max_dist)
+            return INFINITY;
+        if (cmin > 0)
+            w = MIN(floor(max_dist / cmin), w);
+    }
+
+    /* Same matrix computed in vectors */
+    if (align_costs(cs, 4, cost) &&
+        align_edit(x, y, cost, TRUE, cost_ins, MAX(x.len, y.len), w,
+                   max_dist, &a)) {
+        if (max_dist > 0 && a > max_dist)
+            return INFINITY;
+        return lnorm(n, a, x, y);
+    }
 
-    /* Init margin of matrix */
-    for (i = 0; i <= x.len; i++)
-        D(i, 0) = i * cost_ins;
+    /* Three rows of the matrix */
+    if (!mem_reserve((void **) &rows, &cap_rows, 3 * (y.len + 1),
+                     sizeof(int))) {
+        error("Failed to allocate memory for OSA distance");
+        return 0;
+    }
+    int *d = rows;
+
+    /* Init first row of matrix */
     for (j = 0; j <= y.len; j++)
         D(0, j) = j * cost_ins;
 
     for (i = 1; i <= x.len; i++) {
-        for (j = 1; j <= y.len; j++) {
+        jl = MAX(1, i - w);
+        jh = MIN(y.len, i + w);
+        D(i, jl - 1) = jl > 1 ? BAND_INF : i * cost_ins;
+        lo = D(i, jl - 1);
+
+        for (j = jl; j <= jh; j++) {
 
             /* Comparison */
             c = hstring_compare(x, i - 1, y, j - 1);
@@ -106,13 +153,70 @@ float dist_osa_compare(hstring_t x, hstring_t y)
 
             /* Update matrix */
             D(i, j) = a;
+            if (lo > a)
+                lo = a;
         }
+        if (jh < y.len)
+            D(i, jh + 1) = BAND_INF;
+
+        /* All cells of two rows exceed the bound (transpositions skip one) */
+        if (max_dist > 0 && lo > max_dist && last > max_dist)
+            return INFINITY;
+        last = lo;
     }
 
     double m = D(x.len, y.len);
-    free(d);
+
+    if (max_dist > 0 && m > max_dist)
+        return INFINITY;
 
     return lnorm(n, m, x, y);
 }
 
+/**
+ * Computes the OSA distances of a string and several strings. Only equal
+ * costs of insertion and deletion are supported, for which the distance
+ * is symmetric. Short strings of bytes are compared in SIMD lanes if all
+ * costs are integers, as the matrix holds integers.
+ * @param x first string
+ * @param y array of strings
+ * @param num number of strings
+ * @param out array of distances
+ * @return true if the distances are computed, false otherwise
+ */
+int dist_osa_compare_many(hstring_t x, hstring_t *y, int num, float *out)
+{
+    int i, j, c, d[LANES_NUM], cost[4] = { -1, -1, -1, -1 };
+    double m, cs[4] = { cost_ins, cost_del, cost_sub, cost_tra };
+
+    if (cost_ins != cost_del)
+        return FALSE;
+
+    for (i = 0; i < 4; i++)
+        if (cs[i] == floor(cs[i]) && cs[i] >= 0 && cs[i] <= LANES_MAX)
+            cost[i] = cs[i];
+
+    for (i = 0; i < num; i += LANES_NUM) {
+        c = MIN(num - i, LANES_NUM);
+        if (!lanes_osa(x, y + i, c, cost, d)) {
+            for (j = 0; j < c; j++)
+                out[i + j] = dist_osa_compare(x, y[i + j]);
+            continue;
+        }
+
+        /* Same as the comparison of two strings */
+        for (j = 0; j < c; j++) {
+            m = d[j];
+            if (x.len == 0 && y[i + j].len == 0)
+                out[i + j] = 0;
+            else if (max_dist > 0 && m > max_dist)
+                out[i + j] = INFINITY;
+            else
+                out[i + j] = lnorm(n, m, x, y[i + j]);
+        }
+    }
+
+    return TRUE;
+}
+
 /** @} */
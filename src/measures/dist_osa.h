@@ -17,5 +17,6 @@
 /* Module interface */
 void dist_osa_config();
 float dist_osa_compare(hstring_t, hstring_t);
+int dist_osa_compare_many(hstring_t, hstring_t *, int, float *);
 
 #endif /* DIST_OSA_H */
@@ -0,0 +1,385 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+#include "config.h"
+#include "common.h"
+#include "harry.h"
+#include "util.h"
+#include "norm.h"
+#include "filter.h"
+
+/**
+ * @addtogroup measures
+ * <hr>
+ * <em>filter</em>: Cascade of filters for edit distances.
+ *
+ * If only distances within a threshold are kept, pairs of strings can be
+ * rejected using cheap lower bounds of the edit distance. The stages of
+ * the cascade are evaluated in the configured order and the measure is
+ * only computed for the pairs passing all stages. Each stage bounds the
+ * number of edit operations, which is scaled by the smallest cost of an
+ * operation and normalized like the distance.
+ *
+ * Ukkonen. Approximate string-matching with q-grams and maximal matches.
+ * Theoretical Computer Science, 92(1), 191-211, 1992.
+ *
+ * @{
+ */
+
+/* Static variables */
+static filter_t *stages[FILTER_STAGES];
+static long passed[FILTER_STAGES];
+static long rejected[FILTER_STAGES];
+static int num = 0;
+static int tra = FALSE;
+static double cost = 1.0;
+static double threshold = NAN;
+static lnorm_t n = LN_NONE;
+
+/* External variables */
+extern config_t cfg;
+
+/* Measures supporting filters */
+static char *supported[] = {
+    "dist_levenshtein", "dist_damerau", "dist_osa", NULL
+};
+
+/* Costs of edit operations */
+static char *costs[] = {
+    "cost_ins", "cost_del", "cost_sub", "cost_tra", NULL
+};
+
+/**
+ * Lower bound from the difference of lengths
+ * @param x first string
+ * @param y second string
+ * @param t flag for transpositions
+ * @return number of edit operations
+ */
+static float bound_length(hstring_t x, hstring_t y, int t)
+{
+    return abs(x.len - y.len);
+}
+
+/* Counts of q-grams of bytes of the current thread (kept zero) */
+static int *counts = NULL;
+static size_t cap_counts = 0;
+
+/* Hash values of q-grams of other strings of the current thread */
+static uint64_t *grams[2] = { NULL, NULL };
+static size_t cap_grams[2] = { 0, 0 };
+
+#ifdef HAVE_OPENMP
+#pragma omp threadprivate(counts, cap_counts, grams, cap_grams)
+#endif
+
+/**
+ * Comparison function for sorting hash values
+ * @param a first hash value
+ * @param b second hash value
+ * @return result of comparison
+ */
+static int cmp_hash(const void *a, const void *b)
+{
+    uint64_t x = *(uint64_t *) a, y = *(uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Extract the sorted hash values of all q-grams of a string into the
+ * scratch memory of the current thread
+ * @param x string
+ * @param q length of q-grams
+ * @param k index of scratch array
+ * @param len pointer to number of q-grams
+ * @return array of hash values or NULL on error
+ */
+static uint64_t *grams_extract(hstring_t x, int q, int k, int *len)
+{
+    uint64_t *g, h;
+
+    *len = MAX(0, x.len - q + 1);
+    if (!mem_reserve((void **) &grams[k], &cap_grams[k], MAX(1, *len),
+                     sizeof(uint64_t))) {
+        error("Could not allocate memory for q-grams");
+        return NULL;
+    }
+
+    g = grams[k];
+    for (int i = 0; i < *len; i++) {
+        h = 0xcbf29ce484222325ULL;
+        for (int j = 0; j < q; j++)
+            h = (h ^ hstring_get(x, i + j)) * 0x100000001b3ULL;
+        g[i] = h;
+    }
+
+    qsort(g, *len, sizeof(uint64_t), cmp_hash);
+    return g;
+}
+
+/**
+ * Code of the q-gram at a position of a string of bytes
+ * @param s bytes of string
+ * @param i position
+ * @param q length of q-gram
+ * @return code of q-gram
+ */
+static inline int grams_code(const uint8_t *s, int i, int q)
+{
+    int c = 0;
+
+    for (int j = 0; j < q; j++)
+        c = (c << 8) | s[i + j];
+    return c;
+}
+
+/**
+ * Count the q-grams shared by two strings of bytes using a table of
+ * counts. Only the entries of the q-grams are reset, such that no memory
+ * is allocated or cleared for each pair.
+ * @param x first string
+ * @param y second string
+ * @param q length of q-grams (at most FILTER_Q)
+ * @return number of shared q-grams or maximum length on error
+ */
+static int grams_count(hstring_t x, hstring_t y, int q)
+{
+    const uint8_t *xs = (uint8_t *) x.str.c, *ys = (uint8_t *) y.str.c;
+    int i, g, c = 0, *cnt;
+    int xl = MAX(0, x.len - q + 1), yl = MAX(0, y.len - q + 1);
+
+    if (!mem_reserve((void **) &counts, &cap_counts, 1 << (8 * FILTER_Q),
+                     sizeof(int))) {
+        error("Could not allocate memory for q-grams");
+        return MAX(x.len, y.len);
+    }
+
+    cnt = counts;
+    for (i = 0; i < xl; i++)
+        cnt[grams_code(xs, i, q)]++;
+    for (i = 0; i < yl; i++) {
+        g = grams_code(ys, i, q);
+        if (cnt[g]-- > 0)
+            c++;
+    }
+
+    for (i = 0; i < xl; i++)
+        cnt[grams_code(xs, i, q)] = 0;
+    for (i = 0; i < yl; i++)
+        cnt[grams_code(ys, i, q)] = 0;
+
+    return c;
+}
+
+/**
+ * Count the q-grams shared by two strings (multiset intersection).
+ * Tokens and bits are compared as sorted hash values, where collisions only
+ * increase the count and thus weaken, but do not invalidate the lower
+ * bounds.
+ * @param x first string
+ * @param y second string
+ * @param q length of q-grams
+ * @return number of shared q-grams or maximum length on error
+ */
+static int grams_common(hstring_t x, hstring_t y, int q)
+{
+    int i = 0, j = 0, c = 0, xl, yl;
+    uint64_t *xg, *yg;
+
+    if (x.type == TYPE_BYTE)
+        return grams_count(x, y, q);
+
+    xg = grams_extract(x, q, 0, &xl);
+    yg = grams_extract(y, q, 1, &yl);
+    if (!xg || !yg)
+        return MAX(x.len, y.len);
+
+    while (i < xl && j < yl) {
+        if (xg[i] < yg[j]) {
+            i++;
+        } else if (xg[i] > yg[j]) {
+            j++;
+        } else {
+            i++, j++, c++;
+        }
+    }
+
+    return c;
+}
+
+/**
+ * Lower bound from the bag distance. The symbols of both strings are
+ * compared as multisets, where each operation changes at most one symbol.
+ * @param x first string
+ * @param y second string
+ * @param t flag for transpositions
+ * @return number of edit operations
+ */
+static float bound_bag(hstring_t x, hstring_t y, int t)
+{
+    return MAX(x.len, y.len) - grams_common(x, y, 1);
+}
+
+/**
+ * Lower bound from shared q-grams. Each operation destroys at most q
+ * q-grams and each transposition at most q + 1 (q-gram lemma).
+ * @param x first string
+ * @param y second string
+ * @param t flag for transpositions
+ * @return number of edit operations
+ */
+static float bound_qgram(hstring_t x, hstring_t y, int t)
+{
+    int q = FILTER_Q;
+    int d = MAX(x.len, y.len) - q + 1 - grams_common(x, y, q);
+
+    return fmax(0, d / (float) (t ? q + 1 : q));
+}
+
+/* Table of stages */
+static filter_t table[] = {
+    {"length", bound_length},
+    {"bag", bound_bag},
+    {"qgram", bound_qgram},
+    {NULL}
+};
+
+/**
+ * Configures the filter cascade for a similarity measure. The stages are
+ * given as a comma-separated list in the configuration.
+ * @param measure Name of similarity measure
+ */
+void filter_config(const char *measure)
+{
+    const char *str;
+    char buf[256], *list, *tok;
+    double c;
+    int i;
+
+    num = 0;
+    tra = FALSE;
+    cost = 1.0;
+    threshold = NAN;
+
+    config_lookup_string(&cfg, "measures.filter", &str);
+    if (strlen(str) == 0)
+        return;
+
+    for (i = 0; supported[i]; i++)
+        if (!strcmp(measure, supported[i]))
+            break;
+    if (!supported[i]) {
+        warning("Filters are not supported for measure '%s'.", measure);
+        return;
+    }
+
+    /*
+     * Lower bounds are scaled by the smallest cost of an operation. The
+     * costs are truncated and limited to 1, as the edit distances are
+     * computed using integers and unit costs at the margins.
+     */
+    for (i = 0; costs[i]; i++) {
+        snprintf(buf, 256, "measures.%s.%s", measure, costs[i]);
+        if (!config_lookup_float(&cfg, buf, &c))
+            continue;
+        cost = fmin(cost, floor(c));
+        if (!strcmp(costs[i], "cost_tra"))
+            tra = TRUE;
+    }
+
+    snprintf(buf, 256, "measures.%s.norm", measure);
+    config_lookup_string(&cfg, buf, &str);
+    n = lnorm_get(str);
+
+    /* Parse list of stages */
+    config_lookup_string(&cfg, "measures.filter", &str);
+    list = strdup(str);
+    for (tok = strtok(list, ", "); tok; tok = strtok(NULL, ", ")) {
+        for (i = 0; table[i].name; i++)
+            if (!strcasecmp(tok, table[i].name))
+                break;
+        if (!table[i].name) {
+            warning("Unknown filter '%s'. Skipping.", tok);
+            continue;
+        }
+        if (num == FILTER_STAGES) {
+            warning("Too many filters. Skipping '%s'.", tok);
+            continue;
+        }
+        passed[num] = rejected[num] = 0;
+        stages[num++] = table + i;
+    }
+    free(list);
+}
+
+/**
+ * Sets the threshold of the filter cascade. Pairs of strings with a
+ * lower bound above the threshold are rejected.
+ * @param t Threshold of distances
+ */
+void filter_threshold(double t)
+{
+    threshold = t;
+}
+
+/**
+ * Checks whether the filter cascade is enabled
+ * @return true if pairs may be rejected, false otherwise
+ */
+int filter_active(void)
+{
+    return num > 0 && !isnan(threshold);
+}
+
+/**
+ * Runs the filter cascade on a pair of strings
+ * @param x first string
+ * @param y second string
+ * @return true if rejected, false otherwise
+ */
+int filter_reject(hstring_t x, hstring_t y)
+{
+    float b;
+
+    if (!filter_active())
+        return FALSE;
+
+    for (int i = 0; i < num; i++) {
+        b = stages[i]->bound(x, y, tra);
+        if (lnorm(n, b * cost, x, y) > threshold) {
+#ifdef HAVE_OPENMP
+#pragma omp atomic
+#endif
+            rejected[i]++;
+            return TRUE;
+        }
+#ifdef HAVE_OPENMP
+#pragma omp atomic
+#endif
+        passed[i]++;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Print the counters of the filter cascade
+ */
+void filter_print(void)
+{
+    if (num == 0 || isnan(threshold))
+        return;
+
+    for (int i = 0; i < num; i++)
+        info_msg(1, "Filter '%s': %ld passed, %ld rejected.",
+                 stages[i]->name, passed[i], rejected[i]);
+}
+
+/** @} */
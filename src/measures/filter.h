@@ -0,0 +1,40 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "hstring.h"
+
+/* Maximum number of stages in cascade */
+#define FILTER_STAGES   8
+
+/* Length of q-grams for q-gram filter */
+#define FILTER_Q        2
+
+/**
+ * Stage of filter cascade
+ */
+typedef struct
+{
+    /** Name of stage */
+    char *name;
+    /** Lower bound on the number of edit operations */
+    float (*bound) (hstring_t, hstring_t, int);
+} filter_t;
+
+void filter_config(const char *);
+void filter_threshold(double);
+int filter_reject(hstring_t, hstring_t);
+int filter_active(void);
+void filter_print(void);
+
+#endif /* FILTER_H */
@@ -4,7 +4,9 @@ import sys
 measures = set()
 modules = set()
 aliases = {}
+complexity = {}
 description = {}
+batched = {}
 
 # Read data
 for line in open(sys.argv[1]).readlines():
@@ -16,7 +18,9 @@ for line in open(sys.argv[1]).readlines():
     measures.add(ms[0])
     aliases[ms[0]] = ms[1:]
     modules.add(tok[1])
-    description[ms[0]] = tok[2]
+    complexity[ms[0]] = int(tok[2])
+    description[ms[0]] = tok[3]
+    batched[ms[0]] = len(tok) > 4 and tok[4] == '1'
     
 # Prepare includes
 includes = ""
@@ -26,9 +30,11 @@ for m in sorted(modules):
 # Prepare interfaces
 interfaces = 'measure_t func[] = {\n'
 for m in sorted(measures):
-    interfaces += '    {"%s", %s_config, %s_compare},\n' % (m,m,m)
+    c = complexity[m]
+    b = '%s_compare_many' % m if batched[m] else 'NULL'
+    interfaces += '    {"%s", %s_config, %s_compare, %d, %s},\n' % (m,m,m,c,b)
     for a in aliases[m]:
-        interfaces += '    {"%s", %s_config, %s_compare},\n' % (a,m,m)
+        interfaces += '    {"%s", %s_config, %s_compare, %d, %s},\n' % (a,m,m,c,b)
 interfaces += '    {NULL}\n};'
 
 # Prepare list
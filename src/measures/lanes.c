@@ -0,0 +1,312 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+#include "config.h"
+#include "common.h"
+#include "util.h"
+#include "lanes.h"
+
+/**
+ * @addtogroup measures
+ * <hr>
+ * <em>lanes</em>: Comparison of one string with many strings in SIMD
+ * lanes.
+ *
+ * A string is compared with up to 16 short strings of bytes at once. The
+ * symbols of the strings are interleaved, such that one vector holds the
+ * j-th symbol of all strings, and each lane computes the dynamic
+ * programming for one pair using 16-bit cells. Lanes of shorter strings
+ * continue with a padding symbol and their result is taken from the
+ * column at their length. The kernels are written using the vector
+ * extensions of the compiler and built for AVX2, SSE4.1 and the default
+ * target, where the best one is chosen at runtime.
+ * @{
+ */
+
+#ifdef ENABLE_SIMD
+
+/* Vector of lanes */
+typedef uint16_t lane_t __attribute__ ((vector_size(2 * LANES_NUM)));
+
+/* Padding symbol differing from all bytes */
+#define LANES_PAD       0x100
+
+#ifdef HAVE_TARGET_CLONES
+#define KERNEL __attribute__ ((target_clones("avx2", "sse4.1", "default")))
+#else
+#define KERNEL
+#endif
+
+/* Minimum of two vectors (evaluates arguments twice) */
+#define LANE_MIN(a, b)  (((a) & (lane_t) ((a) < (b))) | \
+                         ((b) & (lane_t) ((a) >= (b))))
+
+/**
+ * Checks whether strings can be compared in lanes
+ * @param x first string
+ * @param y array of strings
+ * @param n number of strings
+ * @param c maximum cost of an operation
+ * @return true if supported, false otherwise
+ */
+static int lanes_check(hstring_t x, hstring_t *y, int n, int c)
+{
+    int k, m = 0;
+
+    if (x.type != TYPE_BYTE)
+        return FALSE;
+
+    for (k = 0; k < n; k++) {
+        if (y[k].type != TYPE_BYTE || y[k].len > LANES_LEN)
+            return FALSE;
+        m = MAX(m, y[k].len);
+    }
+
+    return (long) (x.len + m + 1) * c <= LANES_MAX;
+}
+
+/**
+ * Interleaves up to LANES_NUM strings. The j-th vector holds the j-th
+ * symbols of all strings.
+ * @param y array of strings
+ * @param n number of strings
+ * @param v array of LANES_LEN vectors
+ * @param len array of LANES_NUM lengths
+ * @return maximum length of strings
+ */
+static int lanes_load(hstring_t *y, int n, lane_t *v, int *len)
+{
+    int i, j, m = 0;
+
+    for (i = 0; i < LANES_NUM; i++) {
+        len[i] = i < n ? y[i].len : 0;
+        m = MAX(m, len[i]);
+    }
+
+    for (j = 0; j < m; j++)
+        for (i = 0; i < LANES_NUM; i++)
+            v[j][i] = j < len[i] ? (uint8_t) y[i].str.c[j] : LANES_PAD;
+
+    return m;
+}
+
+/**
+ * Computes the Levenshtein distance with unit costs in lanes
+ * @param x first string
+ * @param n length of first string
+ * @param y interleaved strings
+ * @param m maximum length of strings
+ * @param row last row of matrix (m + 1 vectors)
+ */
+KERNEL static void kernel_levenshtein(const uint8_t *x, int n,
+                                      const lane_t *y, int m, lane_t *row)
+{
+    lane_t zero = { 0 }, one = zero + 1, diag, left, up, eq, s, a, b;
+    int i, j;
+
+    for (j = 0; j <= m; j++)
+        row[j] = zero + (uint16_t) j;
+
+    for (i = 0; i < n; i++) {
+        s = zero + (uint16_t) x[i];
+        diag = row[0];
+        left = row[0] = zero + (uint16_t) (i + 1);
+        for (j = 1; j <= m; j++) {
+            up = row[j];
+            eq = (lane_t) (y[j - 1] == s);
+            a = LANE_MIN(up, left) + one;
+            b = diag + one + eq;
+            left = LANE_MIN(a, b);
+            diag = up;
+            row[j] = left;
+        }
+    }
+}
+
+/**
+ * Computes the OSA distance in lanes. The costs are integers.
+ * @param x first string
+ * @param n length of first string
+ * @param y interleaved strings
+ * @param m maximum length of strings
+ * @param c costs of insertion, deletion, substitution and transposition
+ * @param r rows of matrix (3 x (m + 1) vectors)
+ * @return last row of matrix
+ */
+KERNEL static lane_t *kernel_osa(const uint8_t *x, int n, const lane_t *y,
+                                 int m, const int *c, lane_t *r)
+{
+    lane_t zero = { 0 }, eq, tr, a, b, s, s1 = zero;
+    lane_t ins = zero + (uint16_t) c[0], del = zero + (uint16_t) c[1];
+    lane_t sub = zero + (uint16_t) c[2], tra = zero + (uint16_t) c[3];
+    lane_t *cur = r, *prev = r + m + 1, *prev2 = r + 2 * (m + 1), *t;
+    int i, j;
+
+    for (j = 0; j <= m; j++)
+        cur[j] = zero + (uint16_t) (j * c[0]);
+
+    for (i = 0; i < n; i++) {
+        t = prev2;
+        prev2 = prev;
+        prev = cur;
+        cur = t;
+
+        s = zero + (uint16_t) x[i];
+        cur[0] = zero + (uint16_t) ((i + 1) * c[0]);
+        for (j = 1; j <= m; j++) {
+            eq = (lane_t) (y[j - 1] == s);
+
+            /* Insertion, deletion and substitution */
+            a = prev[j] + ins;
+            b = cur[j - 1] + del;
+            a = LANE_MIN(a, b);
+            b = prev[j - 1] + (sub & ~eq);
+            a = LANE_MIN(a, b);
+
+            /* Transposition */
+            if (i > 0 && j > 1) {
+                tr = (lane_t) (y[j - 2] == s) & (lane_t) (y[j - 1] == s1);
+                b = prev2[j - 2] + (tra & ~eq);
+                b = LANE_MIN(a, b);
+                a = (b & tr) | (a & ~tr);
+            }
+
+            cur[j] = a;
+        }
+        s1 = s;
+    }
+
+    return cur;
+}
+
+/**
+ * Counts the mismatches within the length of both strings in lanes
+ * @param x first string
+ * @param n length of first string
+ * @param y interleaved strings
+ * @param m maximum length of strings
+ * @param v lengths of strings and returned number of mismatches
+ */
+KERNEL static void kernel_hamming(const uint8_t *x, int n, const lane_t *y,
+                                  int m, lane_t *v)
+{
+    lane_t zero = { 0 }, one = zero + 1, cnt = zero, len = *v, in, eq;
+    int j;
+
+    for (j = 0; j < MIN(n, m); j++) {
+        in = (lane_t) (len > (uint16_t) j);
+        eq = (lane_t) (y[j] == zero + (uint16_t) x[j]);
+        cnt += one & in & ~eq;
+    }
+
+    *v = cnt;
+}
+
+#endif
+
+/**
+ * Computes the Levenshtein distances with unit costs of a string and
+ * several strings of bytes
+ * @param x first string
+ * @param y array of strings
+ * @param n number of strings
+ * @param d array of distances
+ * @return true if the distances are computed, false otherwise
+ */
+int lanes_levenshtein(hstring_t x, hstring_t *y, int n, int *d)
+{
+#ifdef ENABLE_SIMD
+    lane_t v[LANES_LEN], row[LANES_LEN + 1];
+    int i, k, m, len[LANES_NUM];
+
+    if (!lanes_check(x, y, n, 1))
+        return FALSE;
+
+    for (k = 0; k < n; k += LANES_NUM) {
+        m = lanes_load(y + k, n - k, v, len);
+        kernel_levenshtein((uint8_t *) x.str.c, x.len, v, m, row);
+        for (i = 0; i < MIN(n - k, LANES_NUM); i++)
+            d[k + i] = row[len[i]][i];
+    }
+
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * Computes the OSA distances of a string and several strings of bytes
+ * @param x first string
+ * @param y array of strings
+ * @param n number of strings
+ * @param c integer costs of insertion, deletion, substitution and
+ *        transposition
+ * @param d array of distances
+ * @return true if the distances are computed, false otherwise
+ */
+int lanes_osa(hstring_t x, hstring_t *y, int n, const int *c, int *d)
+{
+#ifdef ENABLE_SIMD
+    lane_t v[LANES_LEN], r[3 * (LANES_LEN + 1)], *row;
+    int i, k, m, len[LANES_NUM];
+    int cmax = MAX(MAX(c[0], c[1]), MAX(c[2], c[3]));
+
+    if (MIN(MIN(c[0], c[1]), MIN(c[2], c[3])) < 0 ||
+        !lanes_check(x, y, n, MAX(cmax, 1)))
+        return FALSE;
+
+    for (k = 0; k < n; k += LANES_NUM) {
+        m = lanes_load(y + k, n - k, v, len);
+        row = kernel_osa((uint8_t *) x.str.c, x.len, v, m, c, r);
+        for (i = 0; i < MIN(n - k, LANES_NUM); i++)
+            d[k + i] = row[len[i]][i];
+    }
+
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * Computes the Hamming distances of a string and several strings of
+ * bytes. Remaining symbols of the longer string are mismatches.
+ * @param x first string
+ * @param y array of strings
+ * @param n number of strings
+ * @param d array of distances
+ * @return true if the distances are computed, false otherwise
+ */
+int lanes_hamming(hstring_t x, hstring_t *y, int n, int *d)
+{
+#ifdef ENABLE_SIMD
+    lane_t v[LANES_LEN], cnt;
+    int i, k, m, len[LANES_NUM];
+
+    if (!lanes_check(x, y, n, 1))
+        return FALSE;
+
+    for (k = 0; k < n; k += LANES_NUM) {
+        m = lanes_load(y + k, n - k, v, len);
+        for (i = 0; i < LANES_NUM; i++)
+            cnt[i] = len[i];
+        kernel_hamming((uint8_t *) x.str.c, x.len, v, m, &cnt);
+        for (i = 0; i < MIN(n - k, LANES_NUM); i++)
+            d[k + i] = cnt[i] + abs(len[i] - x.len);
+    }
+
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/** @} */
@@ -0,0 +1,30 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef LANES_H
+#define LANES_H
+
+#include "hstring.h"
+
+/* Number of strings compared at once */
+#define LANES_NUM       16
+
+/* Maximum length of strings in lanes */
+#define LANES_LEN       256
+
+/* Maximum value of cells in lanes */
+#define LANES_MAX       65535
+
+int lanes_levenshtein(hstring_t, hstring_t *, int, int *);
+int lanes_osa(hstring_t, hstring_t *, int, const int *, int *);
+int lanes_hamming(hstring_t, hstring_t *, int, int *);
+
+#endif /* LANES_H */
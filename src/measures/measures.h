@@ -25,12 +25,19 @@ typedef struct
     void (*measure_config) ();
     /** Comparison function */
     float (*measure_compare) (hstring_t, hstring_t);
+    /** Complexity in the length of strings (1 = linear, 2 = quadratic) */
+    int complexity;
+    /** Batched comparison function (optional) */
+    int (*measure_compare_many) (hstring_t, hstring_t *, int, float *);
 } measure_t;
 
 /* Module functions */
 int measure_match(const char *);
 char *measure_config(const char *);
 double measure_compare(hstring_t, hstring_t);
+int measure_compare_many(hstring_t, hstring_t *, int, float *);
+int measure_complexity(void);
+int measure_symmetric(void);
 void measure_fprint(FILE *);
 
 #endif /* MEASURES_H */
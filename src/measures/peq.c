@@ -0,0 +1,186 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+#include "config.h"
+#include "common.h"
+#include "util.h"
+#include "peq.h"
+
+/**
+ * @addtogroup measures
+ * <hr>
+ * <em>peq</em>: Pattern-equality tables for bit-parallel measures.
+ *
+ * Bit-parallel algorithms encode one string as a table that maps each
+ * symbol to the bit vector of its positions. Bytes index the table
+ * directly, while tokens are stored in a table with open addressing.
+ * Each thread keeps its own table, which is only cleared for the
+ * symbols of the last pattern, such that no memory is allocated once
+ * the table is large enough.
+ * @{
+ */
+
+/* Table of the current thread */
+static peq_t peq = { 0 };
+#ifdef HAVE_OPENMP
+#pragma omp threadprivate(peq)
+#endif
+
+/**
+ * Returns the slot of a token and inserts the token if it is missing
+ * @param p Table
+ * @param s Token
+ * @return slot of the token
+ */
+static long insert(peq_t *p, sym_t s)
+{
+    uint64_t m = (1ULL << (64 - p->shift)) - 1;
+    long k = peq_slot(p, s);
+
+    if (k >= 0)
+        return k;
+
+    k = (s * 0x9e3779b97f4a7c15ULL) >> p->shift;
+    while (p->used[k])
+        k = (k + 1) & m;
+    p->used[k] = TRUE;
+    p->keys[k] = s;
+    return k;
+}
+
+/**
+ * Sets the bits of the symbols of a pattern
+ * @param p Table
+ * @param x String of bytes or tokens
+ */
+static void fill(peq_t *p, hstring_t x)
+{
+    uint64_t *bits = p->bits;
+    int w = p->words;
+    long i, k;
+
+    for (i = 0; i < x.len; i++) {
+        if (x.type == TYPE_BYTE)
+            k = (uint8_t) x.str.c[i];
+        else
+            k = insert(p, x.str.s[i]);
+        bits[k * w + i / 64] |= 1ULL << (i % 64);
+    }
+}
+
+/**
+ * Prepares the table for the symbols of a string
+ * @param p Table
+ * @param x String of bytes or tokens
+ * @param size Returned number of slots
+ * @return true on success, false otherwise
+ */
+static int prepare(peq_t *p, hstring_t x, size_t *size)
+{
+    assert(x.type == TYPE_BYTE || x.type == TYPE_TOKEN);
+
+    p->type = x.type;
+    p->len = x.len;
+
+    if (x.type == TYPE_BYTE) {
+        *size = 256;
+        return TRUE;
+    }
+
+    for (*size = 16, p->shift = 60; *size < 2 * (size_t) x.len; p->shift--)
+        *size <<= 1;
+    return mem_reserve((void **) &p->keys, &p->cap_keys, *size,
+                       sizeof(sym_t)) &&
+        mem_reserve((void **) &p->used, &p->cap_used, *size, 1);
+}
+
+/**
+ * Builds the pattern-equality table of a string for the current thread.
+ * The table remains valid until it is cleared using peq_clear().
+ * @param x String of bytes or tokens
+ * @return table or NULL on error
+ */
+peq_t *peq_build(hstring_t x)
+{
+    peq_t *p = &peq;
+    size_t size;
+    int ok;
+
+    p->words = MAX(1, (x.len + 63) / 64);
+    ok = prepare(p, x, &size);
+
+    /* Bit vectors of symbols and scratch vectors */
+    ok = ok && mem_reserve((void **) &p->bits, &p->cap_bits,
+                           size * p->words, sizeof(uint64_t));
+    ok = ok && mem_reserve((void **) &p->zero, &p->cap_zero, p->words,
+                           sizeof(uint64_t));
+    ok = ok && mem_reserve((void **) &p->state, &p->cap_state,
+                           4 * p->words, sizeof(uint64_t));
+    if (!ok) {
+        error("Failed to allocate memory for pattern-equality table");
+        return NULL;
+    }
+
+    fill(p, x);
+    return p;
+}
+
+/**
+ * Builds only the slots of the tokens of a string for the current
+ * thread, such that tokens can be mapped to small integers. No bit
+ * vectors are set. The table remains valid until it is cleared using
+ * peq_clear().
+ * @param x String of bytes or tokens
+ * @return table or NULL on error
+ */
+peq_t *peq_index(hstring_t x)
+{
+    peq_t *p = &peq;
+    size_t size;
+    long i;
+
+    p->words = 0;
+    if (!prepare(p, x, &size)) {
+        error("Failed to allocate memory for pattern-equality table");
+        return NULL;
+    }
+
+    if (x.type == TYPE_TOKEN)
+        for (i = 0; i < x.len; i++)
+            insert(p, x.str.s[i]);
+
+    return p;
+}
+
+/**
+ * Clears the pattern-equality table for the next string. Only the words
+ * set for the symbols of the pattern are reset.
+ * @param p Table
+ * @param x String of the table
+ */
+void peq_clear(peq_t *p, hstring_t x)
+{
+    uint64_t *bits = p->bits;
+    int w = p->words;
+    long i, k;
+
+    for (i = 0; i < x.len && w > 0; i++) {
+        if (x.type == TYPE_BYTE)
+            k = (uint8_t) x.str.c[i];
+        else
+            k = peq_slot(p, x.str.s[i]);
+        bits[k * w + i / 64] = 0;
+    }
+
+    if (x.type == TYPE_TOKEN)
+        memset(p->used, 0, 1UL << (64 - p->shift));
+}
+
+/** @} */
@@ -0,0 +1,81 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#ifndef PEQ_H
+#define PEQ_H
+
+#include "hstring.h"
+
+/**
+ * Pattern-equality table of a string. For each symbol, a bit vector of
+ * len bits marks the positions of the symbol in the string. The bit
+ * vectors are stored as rows of 64-bit words.
+ */
+typedef struct
+{
+    int type;           /**< Type of pattern */
+    int len;            /**< Length of pattern */
+    int words;          /**< Number of words per bit vector or 0 */
+    int shift;          /**< Shift of hash for tokens */
+    uint64_t *bits;     /**< Bit vectors of symbols */
+    sym_t *keys;        /**< Symbols of slots (tokens) */
+    uint8_t *used;      /**< Occupied slots (tokens) */
+    uint64_t *zero;     /**< Bit vector of unknown symbols */
+    uint64_t *state;    /**< Scratch vectors of the caller (4 x words) */
+    size_t cap_bits;    /**< Capacity of bit vectors */
+    size_t cap_keys;    /**< Capacity of symbols */
+    size_t cap_used;    /**< Capacity of slots */
+    size_t cap_zero;    /**< Capacity of unknown bit vector */
+    size_t cap_state;   /**< Capacity of scratch vectors */
+} peq_t;
+
+peq_t *peq_build(hstring_t);
+peq_t *peq_index(hstring_t);
+void peq_clear(peq_t *, hstring_t);
+
+/**
+ * Returns the slot of a token in a pattern-equality table
+ * @param p Table
+ * @param s Token
+ * @return slot or -1 if the token is not in the pattern
+ */
+static inline long peq_slot(const peq_t *p, sym_t s)
+{
+    uint64_t m = (1ULL << (64 - p->shift)) - 1;
+    uint64_t i = (s * 0x9e3779b97f4a7c15ULL) >> p->shift;
+
+    while (p->used[i]) {
+        if (p->keys[i] == s)
+            return i;
+        i = (i + 1) & m;
+    }
+    return -1;
+}
+
+/**
+ * Returns the bit vector of the j-th symbol of a string
+ * @param p Table
+ * @param y String
+ * @param j Position in string
+ * @return bit vector of the symbol
+ */
+static inline const uint64_t *peq_get(const peq_t *p, hstring_t y, int j)
+{
+    long i;
+
+    if (p->type == TYPE_BYTE)
+        return p->bits + (uint8_t) y.str.c[j] * p->words;
+
+    i = peq_slot(p, y.str.s[j]);
+    return i < 0 ? p->zero : p->bits + i * p->words;
+}
+
+#endif /* PEQ_H */
@@ -37,7 +37,7 @@
 typedef struct
 {
     int (*output_open) (char *);
-    int (*output_write) (hmatrix_t *);
+    long (*output_write) (hmatrix_t *);
     void (*output_close) (void);
 } output_t;
 static output_t func;
@@ -94,11 +94,13 @@ int output_open(char *name)
 }
 
 /**
- * Wrapper for writing a block to the output destination.
+ * Wrapper for writing a block to the output destination. Only the block
+ * of rows held in the matrix is written. The function is called once for
+ * each block in ascending order.
  * @param m Matrix of similarity values 
  * @return Number of written values
  */
-int output_write(hmatrix_t *m)
+long output_write(hmatrix_t *m)
 {
     return func.output_write(m);
 }
@@ -19,7 +19,7 @@ void output_config(const char *);
 
 /* Generic interface */
 int output_open(char *);
-int output_write(hmatrix_t *);
+long output_write(hmatrix_t *);
 void output_close(void);
 
 #endif /* OUTPUT_H */
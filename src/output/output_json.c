@@ -74,25 +74,23 @@ int output_json_open(char *fn)
 }
 
 /**
- * Write similarity matrux to output
- * @param m Matrix of similarity values 
- * @return Number of written values
+ * Write indices, labels and sources of the matrix
+ * @param m Matrix of similarity values
  */
-int output_json_write(hmatrix_t *m)
+static void write_header(hmatrix_t *m)
 {
-    assert(m);
-    int i, j, k = 0;
+    long j;
 
     if (save_indices) {
         output_printf(z, "  \"col_indices\": [");
         for (j = m->col.start; j < m->col.end; j++) {
-            output_printf(z, "%d", j);
+            output_printf(z, "%ld", j);
             if (j < m->col.end - 1)
                 output_printf(z, ", ");
         }
         output_printf(z, "],\n  \"row_indices\": [");
         for (j = m->row.start; j < m->row.end; j++) {
-            output_printf(z, "%d", j);
+            output_printf(z, "%ld", j);
             if (j < m->row.end - 1)
                 output_printf(z, ", ");
         }
@@ -130,9 +128,56 @@ int output_json_write(hmatrix_t *m)
         }
         output_printf(z, "],\n");
     }
+}
+
+/**
+ * Write sparse similarity values as list of coordinates. Each
+ * coordinate holds the row index, the column index and the value.
+ * @param m Matrix of similarity values
+ * @return Number of written values
+ */
+static long write_sparse(hmatrix_t *m)
+{
+    hsparse_t *sp = m->sparse;
+    long i, k, *ptr = sp->ptr - m->row.start;
+
+    write_header(m);
+    output_printf(z, "  \"sparse\": [\n");
 
-    output_printf(z, "  \"matrix\": [\n");
     for (i = m->row.start; i < m->row.end; i++) {
+        for (k = ptr[i]; k < ptr[i + 1]; k++) {
+            float val = hround(sp->vals[k], precision);
+            output_printf(z, "    [%ld, %ld, %g]", i, sp->cols[k], val);
+            if (k < sp->nnz - 1)
+                output_printf(z, ",");
+            output_printf(z, "\n");
+        }
+    }
+
+    output_printf(z, "  ]\n");
+    return sp->nnz;
+}
+
+/**
+ * Write similarity matrux to output
+ * @param m Matrix of similarity values 
+ * @return Number of written values
+ */
+long output_json_write(hmatrix_t *m)
+{
+    assert(m);
+    long i, j, k = 0;
+
+    if (m->sparse)
+        return write_sparse(m);
+
+    /* Write header with first block of rows */
+    if (m->block.start == m->row.start) {
+        write_header(m);
+        output_printf(z, "  \"matrix\": [\n");
+    }
+
+    for (i = m->block.start; i < m->block.end; i++) {
         output_printf(z, "    [");
         for (j = m->col.start; j < m->col.end; j++) {
             float val = hround(hmatrix_get(m, j, i), precision);
@@ -146,7 +191,11 @@ int output_json_write(hmatrix_t *m)
             output_printf(z, ",");
         output_printf(z, "\n");
     }
-    output_printf(z, "  ]\n");
+
+    /* Close matrix with last block of rows */
+    if (m->block.end == m->row.end)
+        output_printf(z, "  ]\n");
+
     return k;
 }
 
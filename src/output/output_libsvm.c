@@ -65,21 +65,51 @@ int output_libsvm_open(char *fn)
     return TRUE;
 }
 
+/**
+ * Write sparse similarity values. Only the stored values of each row
+ * are written.
+ * @param m Matrix of similarity values
+ * @return Number of written values
+ */
+static long write_sparse(hmatrix_t *m)
+{
+    hsparse_t *sp = m->sparse;
+    long i, k, *ptr = sp->ptr - m->row.start;
+
+    for (i = m->row.start; i < m->row.end; i++) {
+        output_printf(z, "%d 0:%ld", (int) m->labels[i], i + 1);
+        for (k = ptr[i]; k < ptr[i + 1]; k++) {
+            float val = hround(sp->vals[k], precision);
+            if (output_printf(z, " %ld:%g", sp->cols[k] + 1, val) < 0) {
+                error("Could not write to output file");
+                return -k;
+            }
+        }
+        output_printf(z, "\n");
+    }
+
+    return sp->nnz;
+}
+
 /**
  * Write similarity matrux to output
  * @param m Matrix of similarity values 
  * @return Number of written values
  */
-int output_libsvm_write(hmatrix_t *m)
+long output_libsvm_write(hmatrix_t *m)
 {
     assert(m);
-    int i, j, r, k = 0;
+    long i, j, k = 0;
+    int r;
 
-    for (i = m->row.start; i < m->row.end; i++) {
-        output_printf(z, "%d 0:%d", (int) m->labels[i], i + 1);
+    if (m->sparse)
+        return write_sparse(m);
+
+    for (i = m->block.start; i < m->block.end; i++) {
+        output_printf(z, "%d 0:%ld", (int) m->labels[i], i + 1);
         for (j = m->col.start; j < m->col.end; j++) {
             float val = hround(hmatrix_get(m, j, i), precision);
-            r = output_printf(z, " %d:%g", j + 1, val);
+            r = output_printf(z, " %ld:%g", j + 1, val);
             if (r < 0) {
                 error("Could not write to output file");
                 return -k;
@@ -34,6 +34,7 @@ static cfg_int precision = 0;
 static int save_indices = 0;
 static int save_labels = 0;
 static int save_sources = 0;
+static long tag = 0;
 
 /**
  * Pads the output stream
@@ -221,34 +222,125 @@ int output_matlab_open(char *fn)
 }
 
 /**
- * Write a similarity matrix in matlab format
+ * Write a similarity matrix in matlab format. Integer storage types
+ * are kept as integer classes, where the largest integer represents
+ * NaN. All other types are written as single floats.
  * @param m Matrix of similarity values
  * @return Number of written bytes
  */
-static int fwrite_matrix(hmatrix_t *m)
+static long fwrite_matrix(hmatrix_t *m)
 {
-    int r = 0, x, y, i, j;
+    long r = 0, x, y, i, j;
+    int class = MAT_CLASS_SINGLE, type = MAT_TYPE_SINGLE, vtype;
+    size_t size = sizeof(float);
+    char val[sizeof(float)];
 
     x = m->col.end - m->col.start;
     y = m->row.end - m->row.start;
 
+    if (m->type == VALUE_UINT8) {
+        class = MAT_CLASS_UINT8;
+        type = MAT_TYPE_UINT8;
+    } else if (m->type == VALUE_UINT16) {
+        class = MAT_CLASS_UINT16;
+        type = MAT_TYPE_UINT16;
+    }
+    vtype = class == MAT_CLASS_SINGLE ? VALUE_FLOAT : m->type;
+    size = hmatrix_type_size(vtype);
+
+    /* Size of data elements is stored as 32 bit integer */
+    if (x * y * size > UINT32_MAX - 64) {
+        error("Matrix too large for Matlab format");
+        return 0;
+    }
+
+    /* Write tag and header with first block of rows */
+    if (m->block.start == m->row.start) {
+        tag = ftell(f);
+        fwrite_uint32(MAT_TYPE_ARRAY, f);
+        fwrite_uint32(0, f);
+
+        r += fwrite_array_flags(0, class, 0, f);
+        r += fwrite_array_dim(x, y, f);
+        r += fwrite_array_name("matrix", f);
+        r += fwrite_uint32(type, f);
+        r += fwrite_uint32(x * y * size, f);
+    }
+
+    /* Write data */
+    for (i = m->block.start; i < m->block.end; i++) {
+        for (j = m->col.start; j < m->col.end; j++) {
+            hmatrix_pack(vtype, val, hround(hmatrix_get(m, j, i), precision));
+            r += fwrite(val, 1, size, f);
+        }
+    }
+
+    /* Finish matrix with last block of rows */
+    if (m->block.end != m->row.end)
+        return r;
+
+    fpad(f);
+
+    /* Update size in tag */
+    r = ftell(f) - tag - 8;
+    fseek(f, tag + 4, SEEK_SET);
+    fwrite_uint32(r, f);
+    fseek(f, 0, SEEK_END);
+
+    return r + 8;
+}
+
+/**
+ * Write a sparse similarity matrix in matlab format. As for the full
+ * matrix, the matlab matrix is transposed, such that the CSR format of
+ * the similarity values directly maps to the CSC format of matlab.
+ * @param m Matrix of similarity values
+ * @return Number of written bytes
+ */
+static long fwrite_sparse(hmatrix_t *m)
+{
+    hsparse_t *sp = m->sparse;
+    long r = 0, x, y, i;
+    double val;
+
+    x = m->col.end - m->col.start;
+    y = m->row.end - m->row.start;
+
+    /* Size of data elements is stored as 32 bit integer */
+    if (sp->nnz * sizeof(double) > UINT32_MAX - 64 || y >= INT32_MAX) {
+        error("Matrix too large for Matlab format");
+        return 0;
+    }
+
     /* Write tag */
     fwrite_uint32(MAT_TYPE_ARRAY, f);
     fwrite_uint32(0, f);
 
     /* Write header */
-    r += fwrite_array_flags(0, MAT_CLASS_SINGLE, 0, f);
+    r += fwrite_array_flags(0, MAT_CLASS_SPARSE, sp->nnz, f);
     r += fwrite_array_dim(x, y, f);
     r += fwrite_array_name("matrix", f);
-    r += fwrite_uint32(MAT_TYPE_SINGLE, f);
-    r += fwrite_uint32(x * y * sizeof(float), f);
 
-    /* Write data */
-    for (i = m->row.start; i < m->row.end; i++) {
-        for (j = m->col.start; j < m->col.end; j++) {
-            float val = hround(hmatrix_get(m, j, i), precision);
-            r += fwrite_float(val, f);
-        }
+    /* Write row indices of matlab matrix */
+    r += fwrite_uint32(MAT_TYPE_INT32, f);
+    r += fwrite_uint32(sp->nnz * sizeof(int32_t), f);
+    for (i = 0; i < sp->nnz; i++)
+        r += fwrite_uint32(sp->cols[i] - m->col.start, f);
+    r += fpad(f);
+
+    /* Write column offsets of matlab matrix */
+    r += fwrite_uint32(MAT_TYPE_INT32, f);
+    r += fwrite_uint32((y + 1) * sizeof(int32_t), f);
+    for (i = 0; i <= y; i++)
+        r += fwrite_uint32(sp->ptr[i], f);
+    r += fpad(f);
+
+    /* Write data. Matlab supports only sparse matrices of doubles */
+    r += fwrite_uint32(MAT_TYPE_DOUBLE, f);
+    r += fwrite_uint32(sp->nnz * sizeof(double), f);
+    for (i = 0; i < sp->nnz; i++) {
+        val = hround(sp->vals[i], precision);
+        r += fwrite(&val, 1, sizeof(val), f);
     }
     r += fpad(f);
 
@@ -266,9 +358,9 @@ static int fwrite_matrix(hmatrix_t *m)
  * @param name Name of range
  * @return Number of written bytes
  */
-static int fwrite_range(range_t ra, char *name)
+static long fwrite_range(range_t ra, char *name)
 {
-    int r = 0, i;
+    long r = 0, i;
 
     /* Write tag */
     fwrite_uint32(MAT_TYPE_ARRAY, f);
@@ -301,9 +393,9 @@ static int fwrite_range(range_t ra, char *name)
  * @param name Name of labels
  * @return Number of written bytes
  */
-static int fwrite_labels(range_t ra, float *labels, char *name)
+static long fwrite_labels(range_t ra, float *labels, char *name)
 {
-    int r = 0, i;
+    long r = 0, i;
 
     /* Write tag */
     fwrite_uint32(MAT_TYPE_ARRAY, f);
@@ -336,9 +428,9 @@ static int fwrite_labels(range_t ra, float *labels, char *name)
  * @param name Name of sources
  * @return Number of written bytes
  */
-static int fwrite_sources(range_t ra, char **sources, char *name)
+static long fwrite_sources(range_t ra, char **sources, char *name)
 {
-    int r = 0, i;
+    long r = 0, i;
 
     /* Write tag */
     fwrite_uint32(MAT_TYPE_ARRAY, f);
@@ -368,12 +460,17 @@ static int fwrite_sources(range_t ra, char **sources, char *name)
  * @param m Matrix/triangle of similarity values
  * @return Number of written values
  */
-int output_matlab_write(hmatrix_t *m)
+long output_matlab_write(hmatrix_t *m)
 {
-    int r = 0;
+    long r = 0;
 
     /* Write similarity matrix */
-    r += fwrite_matrix(m);
+    if (m->sparse)
+        r += fwrite_sparse(m);
+    else
+        r += fwrite_matrix(m);
+    if (m->block.end != m->row.end)
+        return r;
 
     /* Save indices as vectors */
     if (save_indices) {
@@ -40,7 +40,7 @@
 
 /* matlab output module */
 int output_matlab_open(char *);
-int output_matlab_write(hmatrix_t *);
+long output_matlab_write(hmatrix_t *);
 void output_matlab_close(void);
 
 #endif /* OUTPUT_MATLAB_H */
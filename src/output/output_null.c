@@ -43,7 +43,7 @@ int output_null_open(char *fn)
  * @param m Matrix of similarity values 
  * @return Number of written values
  */
-int output_null_write(hmatrix_t *m)
+long output_null_write(hmatrix_t *m)
 {
     return m->size;
 }
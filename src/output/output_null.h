@@ -14,7 +14,7 @@
 
 /* null output module */
 int output_null_open(char *);
-int output_null_write(hmatrix_t *);
+long output_null_write(hmatrix_t *);
 void output_null_close(void);
 
 #endif /* OUTPUT_NULL_H */
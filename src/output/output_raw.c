@@ -24,6 +24,27 @@
  * of the matrix, fsizes is the size of a float in bytes and array holds the
  * matrix of similarity values as floats.
  *
+ * If a different storage type is selected for the matrix, the array
+ * holds the values in this type. The lowest byte of fsize then gives
+ * the size of a value and the second byte the storage type: 1 for
+ * float16, 2 for uint8, 3 for uint16 and 4 for fixed-point values.
+ *
+ * Sparse matrices are stored in compressed sparse row (CSR) format. The
+ * highest bit of fsize is set and the header is followed by
+ * <pre>
+ * | nnz (uint64) | ptr (uint64) ... | cols (uint32) ... | vals (float) ... |
+ * </pre>
+ * where ptr holds rows + 1 offsets, cols the column indices relative to
+ * the column range and vals the similarity values.
+ *
+ * If indices are saved, the second highest bit of fsize is set and the
+ * header is followed by
+ * <pre>
+ * | col (uint32) | row (uint32) |
+ * </pre>
+ * holding the indices of the first column and row of the matrix. This
+ * allows merging parts of a matrix computed separately.
+ *
  * @{
  */
 
@@ -31,6 +52,7 @@
 #include "common.h"
 #include "util.h"
 #include "output.h"
+#include "output_raw.h"
 #include "harry.h"
 
 /* External variables */
@@ -38,6 +60,7 @@ extern config_t cfg;
 
 /* Local variables */
 static cfg_int precision = 0;
+static int save_indices = 0;
 
 /**
  * Opens a file for writing raw format
@@ -47,6 +70,7 @@ static cfg_int precision = 0;
 int output_raw_open(char *fn)
 {
     config_lookup_int(&cfg, "output.precision", &precision);
+    config_lookup_bool(&cfg, "output.save_indices", &save_indices);
 
     if (!stdout) {
         error("Could not open <stdout>");
@@ -56,42 +80,103 @@ int output_raw_open(char *fn)
     return TRUE;
 }
 
+/**
+ * Write sparse similarity values in CSR format
+ * @param m Matrix of similarity values
+ * @return Number of written values
+ */
+static long write_sparse(hmatrix_t *m)
+{
+    hsparse_t *sp = m->sparse;
+    uint64_t nnz = sp->nnz, ptr;
+    uint32_t col;
+    long i, k;
+    size_t ret;
+
+    ret = fwrite(&nnz, sizeof(nnz), 1, stdout);
+    for (i = 0; i <= m->row.end - m->row.start; i++) {
+        ptr = sp->ptr[i];
+        ret += fwrite(&ptr, sizeof(ptr), 1, stdout);
+    }
+    for (k = 0; k < sp->nnz; k++) {
+        col = sp->cols[k] - m->col.start;
+        ret += fwrite(&col, sizeof(col), 1, stdout);
+    }
+    if (ret != (size_t) (m->row.end - m->row.start + 2 + sp->nnz)) {
+        error("Failed to write sparse matrix structure to stdout");
+        return 0;
+    }
+
+    for (k = 0; k < sp->nnz; k++) {
+        float val = hround(sp->vals[k], precision);
+        if (fwrite(&val, sizeof(float), 1, stdout) != 1) {
+            error("Failed to write raw matrix data to stdout");
+            return -k;
+        }
+    }
+
+    return sp->nnz;
+}
+
 /**
  * Write similarity matrux to output
  * @param m Matrix of similarity values
  * @return Number of written values
  */
-int output_raw_write(hmatrix_t *m)
+long output_raw_write(hmatrix_t *m)
 {
     assert(m);
-    uint32_t ret, rows, cols, fsize, i, j;
+    uint32_t rows, cols, fsize, first[2];
+    long i, j, k = 0;
+    size_t ret, size;
+    char val[sizeof(float)];
+
+    /* Dimensions are stored as 32 bit integers */
+    if (RANGE_LENGTH(m->row) > UINT32_MAX ||
+        RANGE_LENGTH(m->col) > UINT32_MAX || (save_indices &&
+        (m->row.end > UINT32_MAX || m->col.end > UINT32_MAX))) {
+        error("Matrix dimensions too large for raw format");
+        return 0;
+    }
 
     rows = m->row.end - m->row.start;
     cols = m->col.end - m->col.start;
-    fsize = sizeof(float);
-
-    ret = fwrite(&rows, sizeof(rows), 1, stdout);
-    ret += fwrite(&cols, sizeof(cols), 1, stdout);
-    ret += fwrite(&fsize, sizeof(fsize), 1, stdout);
-    if (ret != 3) {
-        error("Failed to write raw matrix header to stdout");
-        return 0;
+    size = m->sparse ? sizeof(float) : hmatrix_type_size(m->type);
+    fsize = size | (m->sparse ? RAW_SPARSE : m->type << RAW_TYPE_SHIFT) |
+        (save_indices ? RAW_INDICES : 0);
+    first[0] = m->col.start;
+    first[1] = m->row.start;
+
+    /* Write header with first block of rows */
+    if (m->block.start == m->row.start) {
+        ret = fwrite(&rows, sizeof(rows), 1, stdout);
+        ret += fwrite(&cols, sizeof(cols), 1, stdout);
+        ret += fwrite(&fsize, sizeof(fsize), 1, stdout);
+        if (save_indices)
+            ret += fwrite(first, sizeof(uint32_t), 2, stdout);
+        if (ret != (save_indices ? 5 : 3)) {
+            error("Failed to write raw matrix header to stdout");
+            return 0;
+        }
     }
 
-    for (i = m->row.start; i < m->row.end; i++) {
+    if (m->sparse)
+        return write_sparse(m);
+
+    for (i = m->block.start; i < m->block.end; i++) {
         for (j = m->col.start; j < m->col.end; j++) {
-            float val = hround(hmatrix_get(m, j, i), precision);
-            ret = fwrite(&val, sizeof(float), 1, stdout);
+            hmatrix_pack(m->type, val,
+                         hround(hmatrix_get(m, j, i), precision));
+            ret = fwrite(val, size, 1, stdout);
             if (ret != 1) {
                 error("Failed to write raw matrix data to stdout");
-                return ret;
+                return -k;
             }
+            k++;
         }
     }
 
-
-
-    return ret;
+    return k;
 }
 
 /**
@@ -12,9 +12,15 @@
 #ifndef OUTPUT_RAW_H
 #define OUTPUT_RAW_H
 
+/* Flags in fsize of raw header */
+#define RAW_SPARSE      0x80000000      /* Sparse matrix in CSR format */
+#define RAW_INDICES     0x40000000      /* First column and row stored */
+#define RAW_TYPE_SHIFT  8               /* Storage type in bits 8 to 15 */
+#define RAW_SIZE_MASK   0xff            /* Size of values in bits 0 to 7 */
+
 /* Raw output module */
 int output_raw_open(char *);
-int output_raw_write(hmatrix_t *);
+long output_raw_write(hmatrix_t *);
 void output_raw_close(void);
 
 #endif /* OUTPUT_RAW_H */
@@ -79,25 +79,55 @@ int output_text_open(char *fn)
     return TRUE;
 }
 
+/**
+ * Write sparse similarity values as list of coordinates. Each line
+ * holds the row index, the column index and the similarity value.
+ * @param m Matrix of similarity values
+ * @return Number of written values
+ */
+static long write_sparse(hmatrix_t *m)
+{
+    hsparse_t *sp = m->sparse;
+    long i, k, *ptr = sp->ptr - m->row.start;
+
+    for (i = m->row.start; i < m->row.end; i++) {
+        for (k = ptr[i]; k < ptr[i + 1]; k++) {
+            float val = hround(sp->vals[k], precision);
+            if (output_printf(z, "%ld%s%ld%s%g\n", i, separator,
+                              sp->cols[k], separator, val) < 0) {
+                error("Could not write to output file");
+                return -k;
+            }
+        }
+    }
+
+    return sp->nnz;
+}
+
 /**
  * Write similarity matrux to output
  * @param m Matrix of similarity values 
  * @return Number of written values
  */
-int output_text_write(hmatrix_t *m)
+long output_text_write(hmatrix_t *m)
 {
     assert(m);
-    int i, j, r, k = 0;
+    long i, j, k = 0;
+    int r;
 
-    if (save_indices) {
+    if (m->sparse)
+        return write_sparse(m);
+
+    /* Write header with first block of rows */
+    if (m->block.start == m->row.start && save_indices) {
         output_printf(z, "#");
         for (j = m->col.start; j < m->col.end; j++) {
-            output_printf(z, " %d", j);
+            output_printf(z, " %ld", j);
         }
         output_printf(z, "\n");
     }
 
-    if (save_labels) {
+    if (m->block.start == m->row.start && save_labels) {
         output_printf(z, "#");
         for (j = m->col.start; j < m->col.end; j++) {
             output_printf(z, " %g", m->labels[j]);
@@ -105,7 +135,7 @@ int output_text_write(hmatrix_t *m)
         output_printf(z, "\n");
     }
 
-    if (save_sources) {
+    if (m->block.start == m->row.start && save_sources) {
         output_printf(z, "#");
         for (j = m->col.start; j < m->col.end; j++) {
             output_printf(z, " %s", m->srcs[j]);
@@ -113,7 +143,7 @@ int output_text_write(hmatrix_t *m)
         output_printf(z, "\n");
     }
 
-    for (i = m->row.start; i < m->row.end; i++) {
+    for (i = m->block.start; i < m->block.end; i++) {
         for (j = m->col.start; j < m->col.end; j++) {
             float val = hround(hmatrix_get(m, j, i), precision);
             r = output_printf(z, "%g", val);
@@ -132,7 +162,7 @@ int output_text_write(hmatrix_t *m)
             output_printf(z, " #");
 
         if (save_indices)
-            output_printf(z, " %d", i);
+            output_printf(z, " %ld", i);
 
         if (save_labels)
             output_printf(z, " %g", m->labels[i]);
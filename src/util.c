@@ -41,6 +41,30 @@ static double pb_start = -1;
 static double log_start = -1;
 
 
+/**
+ * Prints version and copyright information to a file stream
+ * @param f File pointer
+ * @param p Prefix character
+ * @param m Message
+ * @return number of written characters
+ */
+int harry_version(FILE *f, char *p, char *m)
+{
+    return fprintf(f, "%sHarry %s - %s\n", p, PACKAGE_VERSION, m);
+}
+
+/**
+ * Prints version and copyright information to a file stream
+ * @param z File pointer
+ * @param p Prefix character
+ * @param m Message
+ * @return number of written characters
+ */
+int harry_zversion(gzFile z, char *p, char *m)
+{
+    return gzprintf(z, "%sHarry %s - %s\n", p, PACKAGE_VERSION, m);
+}
+
 /**
  * Print a formated info message with timestamp.
  * @param v Verbosity level of message
@@ -412,4 +436,24 @@ float hround(float f, int p)
     return round(f * pow(10, p)) / pow(10, p);
 }
 
+/**
+ * Ensures that an array has a given capacity. The array is zeroed if it
+ * needs to be enlarged, otherwise its content is kept.
+ * @param a Pointer to array
+ * @param cap Pointer to capacity
+ * @param n Required number of elements
+ * @param s Size of elements
+ * @return true on success, false otherwise
+ */
+int mem_reserve(void **a, size_t *cap, size_t n, size_t s)
+{
+    if (n <= *cap)
+        return TRUE;
+
+    free(*a);
+    *a = calloc(n, s);
+    *cap = *a ? n : 0;
+    return *a != NULL;
+}
+
 /** @} */
@@ -43,6 +43,7 @@ int strip_newline(char *s, int l);
 void debug_msg(char *m, ...);
 void log_print(long, long, long);
 float hround(float, int);
+int mem_reserve(void **, size_t *, size_t, size_t);
 
 #define MIN(a, b) (a < b ? a : b)
 #define MAX(a, b) (a > b ? a : b)
@@ -0,0 +1,210 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+/*
+ * Microbenchmark of all similarity measures. Each measure is run on
+ * random strings for the granularities bytes, tokens and bits with
+ * different lengths and alphabet sizes. The cache of similarity values
+ * is bypassed by calling the comparison functions directly, while caches
+ * internal to a measure are used as during normal operation.
+ *
+ * Usage: bench_measures [seconds] [measure ...]
+ */
+
+#include "config.h"
+#include "common.h"
+#include "hconfig.h"
+#include "util.h"
+#include "measures.h"
+#include "tests.h"
+#include "vcache.h"
+
+#include <time.h>
+
+/* Global variables */
+int verbose = 0;
+config_t cfg;
+
+/* Table of measures (see measures.c) */
+extern measure_t func[];
+
+/* Number of string pairs per case */
+#define PAIRS           64
+
+static char *grans[] = { "bytes", "tokens", "bits", NULL };
+static int lengths[] = { 16, 64, 256, 0 };
+static int alphas[] = { 4, 26, 255, 0 };
+
+/* Granularities not supported by measures */
+static char *skip[][2] = {
+    {"dist_lee", "tokens"},
+    {"kern_spectrum", "bits"},
+    {NULL, NULL}
+};
+
+/* Sink for results of comparisons */
+static volatile float sink;
+
+/**
+ * Return the time of a monotonic clock
+ * @return time in seconds
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Generate a random string. Strings over small alphabets use lowercase
+ * letters, larger alphabets all bytes except zero. For tokens, every
+ * few symbols are replaced by a space.
+ * @param buf Buffer of len + 1 bytes
+ * @param len Length of string
+ * @param alpha Size of alphabet
+ * @param tokens Flag for inserting delimiters
+ * @return string
+ */
+static char *rand_str(char *buf, int len, int alpha, int tokens)
+{
+    for (int i = 0; i < len; i++) {
+        if (tokens && lrand48() % 5 == 0)
+            buf[i] = ' ';
+        else if (alpha <= 26)
+            buf[i] = 'a' + lrand48() % alpha;
+        else
+            buf[i] = 1 + lrand48() % alpha;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+/**
+ * Benchmark one measure for one granularity, length and alphabet. The
+ * comparisons are run in batches of increasing size until the time is
+ * up, such that reading the clock is negligible.
+ * @param m Measure
+ * @param gran Granularity
+ * @param len Length of strings in bytes
+ * @param alpha Size of alphabet
+ * @param t Minimum time in seconds
+ */
+static void bench_case(measure_t *m, char *gran, int len, int alpha,
+                       double t)
+{
+    hstring_t x[PAIRS], y[PAIRS];
+    char *buf = malloc(len + 1);
+    long n = 0, k = 1, i, j;
+    double start, el;
+    float r = 0;
+
+    config_set_string(&cfg, "measures.granularity", gran);
+    measure_config(m->name);
+
+    srand48(len * 256 + alpha);
+    for (i = 0; i < PAIRS; i++) {
+        rand_str(buf, len, alpha, !strcmp(gran, "tokens"));
+        x[i] = hstring_preproc(hstring_init(x[i], buf));
+        rand_str(buf, len, alpha, !strcmp(gran, "tokens"));
+        y[i] = hstring_preproc(hstring_init(y[i], buf));
+    }
+
+    start = now();
+    do {
+        for (j = 0; j < k; j++, n++)
+            r += m->measure_compare(x[n % PAIRS], y[n % PAIRS]);
+        el = now() - start;
+        if (el < t / 16)
+            k *= 2;
+    } while (el < t);
+    sink = r;
+
+    printf("%-20s %-6s %5d %5d %12.1f %12.2f\n", m->name, gran, len, alpha,
+           el * 1e9 / n, 2.0 * len * n / el / 1e6);
+    fflush(stdout);
+
+    for (i = 0; i < PAIRS; i++) {
+        hstring_destroy(&x[i]);
+        hstring_destroy(&y[i]);
+    }
+    free(buf);
+}
+
+/**
+ * Check whether a measure supports a granularity
+ * @param name Name of measure
+ * @param gran Granularity
+ * @return true if supported, false otherwise
+ */
+static int supported(char *name, char *gran)
+{
+    for (int i = 0; skip[i][0]; i++)
+        if (!strcmp(name, skip[i][0]) && !strcmp(gran, skip[i][1]))
+            return FALSE;
+
+    return TRUE;
+}
+
+/**
+ * Check whether a measure has been selected on the command line
+ * @param name Name of measure
+ * @param argc Number of arguments
+ * @param argv Argument values
+ * @return true if selected, false otherwise
+ */
+static int selected(char *name, int argc, char **argv)
+{
+    if (argc <= 2)
+        return TRUE;
+
+    for (int i = 2; i < argc; i++)
+        if (!strcmp(name, argv[i]))
+            return TRUE;
+
+    return FALSE;
+}
+
+/**
+ * Main benchmark function
+ */
+int main(int argc, char **argv)
+{
+    double t = argc > 1 ? atof(argv[1]) : 0.05;
+    int i, g, l, a;
+
+    config_init(&cfg);
+    config_check(&cfg);
+    vcache_init();
+
+    printf("# %-18s %-6s %5s %5s %12s %12s\n", "measure", "gran", "len",
+           "alpha", "ns/cmp", "MB/s");
+
+    for (i = 0; func[i].name; i++) {
+        /* Skip aliases of measures */
+        if (i > 0 && func[i].measure_compare == func[i - 1].measure_compare)
+            continue;
+        if (!selected(func[i].name, argc, argv))
+            continue;
+
+        for (g = 0; grans[g]; g++) {
+            if (!supported(func[i].name, grans[g]))
+                continue;
+            for (l = 0; lengths[l]; l++)
+                for (a = 0; alphas[a]; a++)
+                    bench_case(func + i, grans[g], lengths[l], alphas[a], t);
+        }
+    }
+
+    vcache_destroy();
+    config_destroy(&cfg);
+    return EXIT_SUCCESS;
+}
@@ -8,7 +8,8 @@
 # option) any later version.  This program is distributed without any
 # warranty. See the GNU General Public License for more details.
 # --
-# Simple test for one input, two inputs and ranges.
+# Simple test for one input, two inputs, ranges, merging, extension and
+# memory-mapped matrices.
 #
 
 # Check for directories
@@ -21,9 +22,11 @@ HARRY=$BUILDDIR/src/harry
 OUTPUT1=$TMPDIR/harry1-$$.txt
 OUTPUT2=$TMPDIR/harry2-$$.txt
 TMPFILE=$TMPDIR/harry3-$$.txt
-rm -f $OUTPUT1 $OUTPUT2 $TMPFILE
+RAWFILE=$TMPDIR/harry4-$$.raw
+MAPFILE=$TMPDIR/harry5-$$.bin
+rm -f $OUTPUT1 $OUTPUT2 $TMPFILE $RAWFILE $MAPFILE
 
-for i in 1 2 ; do
+for i in 1 2 3 4 5 ; do
    case $i in
    1) 
       # Check one and two inputs 
@@ -37,6 +40,33 @@ for i in 1 2 ; do
       $HARRY -x :8 -y 8: $TMPFILE $OUTPUT2
       ;;
    3)
+      # Check merging of split matrix
+      $HARRY $DATA $OUTPUT1
+      $HARRY -s 2:0 --save_indices $DATA $TMPFILE
+      $HARRY -s 2:1 --save_indices $DATA = > $RAWFILE
+      $HARRY --merge $RAWFILE $TMPFILE $OUTPUT2
+      ;;
+   4)
+      # Check extension of matrix
+      $HARRY $DATA $OUTPUT1
+      head -n 5 $DATA > $TMPFILE
+      $HARRY $TMPFILE = > $RAWFILE
+      $HARRY --extend_file $RAWFILE $DATA $OUTPUT2
+      ;;
+   5)
+      # Check creation, resumption and rejection of memory-mapped matrix
+      $HARRY --mmap_file $MAPFILE $DATA $OUTPUT1
+      $HARRY $DATA $TMPFILE
+      diff $OUTPUT1 $TMPFILE || exit 1
+      # Mark the first value as missing (NaN) after the 4096 byte header
+      printf '\000\000\300\177' | \
+          dd of=$MAPFILE bs=1 seek=4096 conv=notrunc 2> /dev/null
+      $HARRY -v --mmap_file $MAPFILE $DATA $OUTPUT2 2>&1 | \
+          grep "Resuming" > /dev/null || exit 1
+      $HARRY -m dist_hamming --mmap_file $MAPFILE $DATA $TMPFILE \
+          2> /dev/null && exit 1
+      ;;
+   6)
       # Check "invalid ranges"
       $HARRY $DATA $OUTPUT1      
       $HARRY -x 3:5 -y 2:4 $DATA $DATA $OUTPUT2
@@ -51,5 +81,5 @@ for i in 1 2 ; do
 done
 
 # Clean up and exit
-rm -f $OUTPUT1 $OUTPUT2 $TMPFILE
+rm -f $OUTPUT1 $OUTPUT2 $TMPFILE $RAWFILE $MAPFILE
 exit 0
@@ -28,12 +28,46 @@ for OPTION in "-m dist_hamming" "-m kern_spectrum" "-x 2:" "-y 1:-1" \
               "-y :" "-x -1:" "-s 3:1" "-g tokens -d%20%0a%0d" \
               "-g tokens -d%20abcd" "-g tokens -d%20 --soundex" \
               "--reverse_str" "--decode_str" "--save_indices" \
-              "--save_labels" "--save_sources" ; do
+              "--save_labels" "--save_sources" "--row_block 3" \
+              "--threshold 15" "--dedup" "-m dist_jaro --storage float16" \
+              "--threshold 15 --filter length,bag,qgram" \
+              "--knn 3 --graph_links 4" ; do
 
     echo "$OPTION" >> $OUTPUT
     $HARRY -p 4 $OPTION $DATA - | grep -v -E '^#' >> $OUTPUT
 done
 
+# Build and reuse a metric index
+INDEX=$TMPDIR/harry-$$.idx
+for OPTION in "--knn 3" "--threshold 15" ; do
+    for RUN in build reuse ; do
+        echo "$OPTION --index_file ($RUN)" >> $OUTPUT
+        $HARRY -p 4 $OPTION --index_file $INDEX $DATA - | \
+            grep -v -E '^#' >> $OUTPUT
+    done
+    rm -f $INDEX
+done
+
+# Distances beyond a bound must not prune the index
+CONFIG=$TMPDIR/harry-$$.cfg
+echo 'measures = { granularity = "bytes";' > $CONFIG
+echo '    dist_levenshtein = { max_dist = 15.0; }; };' >> $CONFIG
+echo "--threshold 15 --index_file (bounded)" >> $OUTPUT
+$HARRY -c $CONFIG -p 4 --threshold 15 --index_file $INDEX $DATA - | \
+    grep -v -E '^#' >> $OUTPUT
+rm -f $INDEX
+
+# Blocks of rows must not change values of asymmetric costs
+echo 'measures = { granularity = "bytes"; dist_levenshtein = {' > $CONFIG
+echo '    cost_ins = 1.0; cost_del = 2.0; cost_sub = 3.0; }; };' >> $CONFIG
+echo "--row_block 3 (asymmetric costs)" >> $OUTPUT
+$HARRY -c $CONFIG -p 4 --row_block 3 $DATA - | grep -v -E '^#' >> $OUTPUT
+
+# Duplicates cannot be mapped for asymmetric costs
+echo "--dedup (asymmetric costs)" >> $OUTPUT
+$HARRY -c $CONFIG -p 4 --dedup $DATA - 2>&1 | grep -v -E '^#' >> $OUTPUT
+rm -f $CONFIG
+
 # Save output
 #cp $OUTPUT /tmp/check_options.txt
 
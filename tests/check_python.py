@@ -65,3 +65,31 @@ for name in ["hamming", "levenshtein", "bag", "lee"]:
                     sys.exit(1)
     print ".",
 print "Ok"
+
+print "Testing server:",
+# Compare values of server with those of the tool
+import subprocess
+import tempfile
+import time
+sock = os.path.join(tempfile.gettempdir(), "harry-%d.sock" % os.getpid())
+data = os.path.join(tempfile.gettempdir(), "harry-%d.txt" % os.getpid())
+open(data, "w").write('\n'.join(x) + '\n')
+p = subprocess.Popen([harry.__tool, "--serve", sock, data])
+for _ in range(50):
+    if os.path.exists(sock):
+        break
+    time.sleep(0.1)
+
+s = harry.Server(sock)
+m1 = np.array(s.compare_rows(x))
+m2 = harry.compare(x)
+s.close()
+p.terminate()
+p.wait()
+os.remove(data)
+
+if np.linalg.norm(m1 - m2) < 1e-6:
+    print "Ok"
+else:
+    print "Failed"
+    sys.exit(1)
@@ -79,6 +79,70 @@ int test_compare()
     return err;
 }
 
+/**
+ * Sets the costs and the bound of the distance
+ * @param c costs of insertion, deletion, substitution and transposition
+ * @param k bound of distance
+ */
+static void set_costs(const double *c, double k)
+{
+    config_set_float(&cfg, "measures.dist_damerau.cost_ins", c[0]);
+    config_set_float(&cfg, "measures.dist_damerau.cost_del", c[1]);
+    config_set_float(&cfg, "measures.dist_damerau.cost_sub", c[2]);
+    config_set_float(&cfg, "measures.dist_damerau.cost_tra", c[3]);
+    config_set_float(&cfg, "measures.dist_damerau.max_dist", k);
+    measure_config("dist_damerau");
+}
+
+/**
+ * Test weighted costs with random strings. The integer parts of the costs
+ * are equal, where the first costs are computed in vectors and the
+ * second costs with the original matrix.
+ * @return error flag
+ */
+int test_costs()
+{
+    int i, j, k, len, err = FALSE;
+    char buf[2][100];
+    hstring_t x, y;
+    float d, e;
+    double costs[][2][4] = {
+        {{2.5, 1.0, 3.25, 1.5}, {2.95, 1.95, 3.95, 1.95}},
+        {{1.0, 3.0, 0.5, 0.0}, {1.95, 3.95, 0.95, 0.95}},
+    };
+
+    printf("Testing Damerau-Levenshtein distance (costs) ");
+    for (i = 0; i < 200 && !err; i++) {
+        for (k = 0; k < 2; k++) {
+            len = rand() % 80;
+            for (j = 0; j < len; j++)
+                buf[k][j] = 'a' + rand() % 3;
+            buf[k][j] = '\0';
+        }
+        x = hstring_preproc(hstring_init(x, buf[0]));
+        y = hstring_preproc(hstring_init(y, buf[1]));
+
+        for (k = 0; k < 4 && !err; k++) {
+            set_costs(costs[k / 2][0], k % 2 ? 10 : 0);
+            d = measure_compare(x, y);
+            set_costs(costs[k / 2][1], k % 2 ? 10 : 0);
+            e = measure_compare(x, y);
+            if (d != e) {
+                printf("Error %f != %f\n", d, e);
+                err = TRUE;
+            }
+        }
+
+        hstring_destroy(&x);
+        hstring_destroy(&y);
+        if (i % 20 == 0)
+            printf(".");
+    }
+    printf(" done.\n");
+
+    return err;
+}
+
 /**
  * Main test function
  */
@@ -90,6 +154,7 @@ int main(int argc, char **argv)
     config_check(&cfg);
 
     err |= test_compare();
+    err |= test_costs();
 
     config_destroy(&cfg);
     return err;
@@ -86,6 +86,51 @@ int test_compare()
     return err;
 }
 
+/**
+ * Test batched comparison of strings around the length of 64 symbols,
+ * such that strings shorter than the first string and strings too long
+ * for one word fall back to single comparisons. The first string is
+ * empty.
+ */
+int test_many()
+{
+    int i, j, k, len, err = FALSE;
+    char buf[100];
+    hstring_t x[40];
+    float out[40], d;
+    char *names[] = { "dist_jaro", "dist_jarowinkler" };
+
+    printf("Testing Jaro-Winkler distance (batched) ");
+    for (i = 0; i < 40; i++) {
+        len = i == 0 ? 0 : 48 + rand() % 32;
+        for (j = 0; j < len; j++)
+            buf[j] = 'a' + rand() % 4;
+        buf[j] = '\0';
+        x[i] = hstring_preproc(hstring_init(x[i], buf));
+    }
+
+    for (k = 0; k < 2 && !err; k++) {
+        measure_config(names[k]);
+        for (i = 0; i < 40 && !err; i++) {
+            err |= !measure_compare_many(x[i], x, 40, out);
+            for (j = 0; j < 40 && !err; j++) {
+                d = measure_compare(x[i], x[j]);
+                if (fabs(d - out[j]) > 1e-6) {
+                    printf("Error %f != %f\n", out[j], d);
+                    err = TRUE;
+                }
+            }
+        }
+        printf(".");
+    }
+
+    for (i = 0; i < 40; i++)
+        hstring_destroy(&x[i]);
+    printf(" done.\n");
+
+    return err;
+}
+
 /**
  * Main test function
  */
@@ -97,6 +142,7 @@ int main(int argc, char **argv)
     config_check(&cfg);
 
     err |= test_compare();
+    err |= test_many();
 
     config_destroy(&cfg);
     return err;
@@ -116,6 +116,183 @@ int test_compare()
     return err;
 }
 
+/**
+ * Computes the Levenshtein distance of two C strings using the full matrix
+ * @param x first string
+ * @param y second string
+ * @return Levenshtein distance
+ */
+static int reference(const char *x, const char *y)
+{
+    int i, j, a, b, c, n = strlen(x), m = strlen(y);
+    int *d = malloc((n + 1) * (m + 1) * sizeof(int));
+
+    for (i = 0; i <= n; i++)
+        for (j = 0; j <= m; j++) {
+            if (i == 0 || j == 0) {
+                d[i * (m + 1) + j] = i + j;
+                continue;
+            }
+            a = d[(i - 1) * (m + 1) + j] + 1;
+            b = d[i * (m + 1) + j - 1] + 1;
+            c = d[(i - 1) * (m + 1) + j - 1] + (x[i - 1] != y[j - 1]);
+            d[i * (m + 1) + j] = MIN(MIN(a, b), c);
+        }
+
+    a = d[n * (m + 1) + m];
+    free(d);
+    return a;
+}
+
+/**
+ * Creates a random string and its variant with delimiters
+ * @param s buffer for string
+ * @param t buffer for string with delimiters
+ * @param n length of string
+ */
+static void random_string(char *s, char *t, int n)
+{
+    for (int i = 0; i < n; i++) {
+        s[i] = 'a' + rand() % 4;
+        t[2 * i] = s[i];
+        t[2 * i + 1] = '.';
+    }
+    s[n] = t[2 * n] = '\0';
+}
+
+/**
+ * Test runs with random strings of bytes and tokens
+ * @return error flag
+ */
+int test_random()
+{
+    int i, k, n, err = FALSE;
+    char s[2][300], t[2][600];
+    hstring_t x, y;
+    float d, e;
+
+    printf("Testing Levenshtein distance (random) ");
+    measure_config("dist_levenshtein");
+    hstring_delim_set(".");
+
+    for (i = 0; i < 200 && !err; i++) {
+        /* Every other pair is short enough for comparison in lanes */
+        n = i % 2 ? 300 : 25;
+        random_string(s[0], t[0], rand() % n);
+        random_string(s[1], t[1], rand() % n);
+
+        for (k = 0; k < 2 && !err; k++) {
+            config_set_string(&cfg, "measures.granularity",
+                              k ? "tokens" : "bytes");
+            x = hstring_preproc(hstring_init(x, k ? t[0] : s[0]));
+            y = hstring_preproc(hstring_init(y, k ? t[1] : s[1]));
+
+            d = measure_compare(x, y);
+            if (fabs(d - reference(s[0], s[1])) > 1e-6) {
+                printf("Error %f != %d\n", d, reference(s[0], s[1]));
+                err = TRUE;
+            }
+            if (!measure_compare_many(x, &y, 1, &e) || d != e) {
+                printf("Error %f != %f (batched)\n", e, d);
+                err = TRUE;
+            }
+
+            hstring_destroy(&x);
+            hstring_destroy(&y);
+        }
+
+        if (i % 10 == 0)
+            printf(".");
+    }
+    printf(" done.\n");
+
+    return err;
+}
+
+/**
+ * Sets the costs and the bound of the distance
+ * @param c costs of edit operations
+ * @param k bound of distance
+ */
+static void set_costs(const double *c, double k)
+{
+    config_set_float(&cfg, "measures.dist_levenshtein.cost_ins", c[0]);
+    config_set_float(&cfg, "measures.dist_levenshtein.cost_del", c[1]);
+    config_set_float(&cfg, "measures.dist_levenshtein.cost_sub", c[2]);
+    config_set_float(&cfg, "measures.dist_levenshtein.max_dist", k);
+    measure_config("dist_levenshtein");
+}
+
+/**
+ * Test bounded distances with unit and weighted costs. Distances within
+ * the bound are exact, while larger distances are infinite.
+ * @return error flag
+ */
+int test_bound()
+{
+    int i, j, k, l, len, err = FALSE;
+    char s[2][700];
+    hstring_t x, y;
+    float d, e;
+    double bounds[] = { 1, 3, 5.5, 10, 40 };
+    double costs[][3] = { {1, 1, 1}, {2, 1, 1.5}, {1.95, 1.95, 2.95} };
+
+    printf("Testing Levenshtein distance (bounded) ");
+    config_set_string(&cfg, "measures.granularity", "bytes");
+
+    for (i = 0; i < 100 && !err; i++) {
+        /* Long strings span several words of the bit-parallel variant */
+        len = i % 2 ? rand() % 300 : rand() % 40;
+        for (j = 0; j < len; j++)
+            s[0][j] = 'a' + rand() % 4;
+        s[0][len] = '\0';
+
+        /* Variant with a few random edits */
+        for (l = 0, j = 0; j < len; j++) {
+            switch (rand() % (len > 40 ? 64 : 8)) {
+            case 0:
+                break;
+            case 1:
+                s[1][l++] = 'a' + rand() % 4;
+                s[1][l++] = s[0][j];
+                break;
+            case 2:
+                s[1][l++] = 'a' + rand() % 4;
+                break;
+            default:
+                s[1][l++] = s[0][j];
+            }
+        }
+        s[1][l] = '\0';
+
+        x = hstring_preproc(hstring_init(x, s[0]));
+        y = hstring_preproc(hstring_init(y, s[1]));
+
+        for (k = 0; k < 3 && !err; k++) {
+            set_costs(costs[k], 0);
+            d = measure_compare(x, y);
+            for (l = 0; l < 5 && !err; l++) {
+                set_costs(costs[k], bounds[l]);
+                e = measure_compare(x, y);
+                if (d <= bounds[l] ? fabs(d - e) > 1e-4 : !isinf(e)) {
+                    printf("Error %f != %f (bound %g)\n", e, d, bounds[l]);
+                    err = TRUE;
+                }
+            }
+        }
+
+        hstring_destroy(&x);
+        hstring_destroy(&y);
+
+        if (i % 10 == 0)
+            printf(".");
+    }
+    set_costs(costs[0], 0);
+    printf(" done.\n");
+
+    return err;
+}
+
 /**
  * Main test function
  */
@@ -127,6 +304,8 @@ int main(int argc, char **argv)
     config_check(&cfg);
 
     err |= test_compare();
+    err |= test_random();
+    err |= test_bound();
 
     config_destroy(&cfg);
     return err;
@@ -78,6 +78,142 @@ int test_compare()
     return err;
 }
 
+/**
+ * Test batched comparison with random strings and different costs. The
+ * first 32 strings fit into lanes, while the last ones are around the
+ * maximum length of strings in lanes.
+ * @return error flag
+ */
+int test_many()
+{
+    int i, j, k, len, err = FALSE;
+    char buf[300];
+    hstring_t x[40];
+    float out[40], d;
+    double costs[][4] = {
+        {1, 1, 1, 1}, {2, 2, 1, 3}, {1, 1, 2, 0}, {1.5, 1.5, 1, 1}
+    };
+
+    printf("Testing OSA distance (batched) ");
+    for (i = 0; i < 40; i++) {
+        len = i < 32 ? rand() % 40 : 250 + rand() % 20;
+        for (j = 0; j < len; j++)
+            buf[j] = 'a' + rand() % 3;
+        buf[j] = '\0';
+        x[i] = hstring_preproc(hstring_init(x[i], buf));
+    }
+
+    for (k = 0; k < 4 && !err; k++) {
+        config_set_float(&cfg, "measures.dist_osa.cost_ins", costs[k][0]);
+        config_set_float(&cfg, "measures.dist_osa.cost_del", costs[k][1]);
+        config_set_float(&cfg, "measures.dist_osa.cost_sub", costs[k][2]);
+        config_set_float(&cfg, "measures.dist_osa.cost_tra", costs[k][3]);
+        measure_config("dist_osa");
+
+        for (i = 0; i < 40 && !err; i++) {
+            err |= !measure_compare_many(x[i], x, 40, out);
+            for (j = 0; j < 40 && !err; j++) {
+                d = measure_compare(x[j], x[i]);
+                if (fabs(d - out[j]) > 1e-6) {
+                    printf("Error %f != %f\n", out[j], d);
+                    err = TRUE;
+                }
+            }
+        }
+        printf(".");
+    }
+
+    for (i = 0; i < 40; i++)
+        hstring_destroy(&x[i]);
+    printf(" done.\n");
+
+    return err;
+}
+
+/**
+ * Sets the costs and the bound of the distance
+ * @param c costs of edit operations
+ * @param k bound of distance
+ */
+static void set_costs(const double *c, double k)
+{
+    config_set_float(&cfg, "measures.dist_osa.cost_ins", c[0]);
+    config_set_float(&cfg, "measures.dist_osa.cost_del", c[1]);
+    config_set_float(&cfg, "measures.dist_osa.cost_sub", c[2]);
+    config_set_float(&cfg, "measures.dist_osa.cost_tra", c[3]);
+    config_set_float(&cfg, "measures.dist_osa.max_dist", k);
+    measure_config("dist_osa");
+}
+
+/**
+ * Test bounded distances with unit and weighted costs. Distances within
+ * the bound are exact, while larger distances are infinite.
+ * @return error flag
+ */
+int test_bound()
+{
+    int i, j, k, l, len, err = FALSE;
+    char s[2][100];
+    hstring_t x, y;
+    float d, e;
+    double bounds[] = { 1, 3, 5.5, 10 };
+    double costs[][4] = { {1, 1, 1, 1}, {2, 1, 1.5, 1}, {1.95, 1.95, 2.95, 0.95} };
+
+    printf("Testing OSA distance (bounded) ");
+    config_set_string(&cfg, "measures.granularity", "bytes");
+
+    for (i = 0; i < 100 && !err; i++) {
+        len = rand() % 40;
+        for (j = 0; j < len; j++)
+            s[0][j] = 'a' + rand() % 4;
+        s[0][len] = '\0';
+
+        /* Variant with a few random edits */
+        for (l = 0, j = 0; j < len; j++) {
+            switch (rand() % 8) {
+            case 0:
+                break;
+            case 1:
+                s[1][l++] = 'a' + rand() % 4;
+                s[1][l++] = s[0][j];
+                break;
+            case 2:
+                s[1][l++] = 'a' + rand() % 4;
+                break;
+            default:
+                s[1][l++] = s[0][j];
+            }
+        }
+        s[1][l] = '\0';
+
+        x = hstring_preproc(hstring_init(x, s[0]));
+        y = hstring_preproc(hstring_init(y, s[1]));
+
+        for (k = 0; k < 3 && !err; k++) {
+            set_costs(costs[k], 0);
+            d = measure_compare(x, y);
+            for (l = 0; l < 4 && !err; l++) {
+                set_costs(costs[k], bounds[l]);
+                e = measure_compare(x, y);
+                if (d <= bounds[l] ? fabs(d - e) > 1e-4 : !isinf(e)) {
+                    printf("Error %f != %f (bound %g)\n", e, d, bounds[l]);
+                    err = TRUE;
+                }
+            }
+        }
+
+        hstring_destroy(&x);
+        hstring_destroy(&y);
+
+        if (i % 10 == 0)
+            printf(".");
+    }
+    set_costs(costs[0], 0);
+    printf(" done.\n");
+
+    return err;
+}
+
 /**
  * Main test function
  */
@@ -89,6 +225,8 @@ int main(int argc, char **argv)
     config_check(&cfg);
 
     err |= test_compare();
+    err |= test_many();
+    err |= test_bound();
 
     config_destroy(&cfg);
     return err;
@@ -0,0 +1,128 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "common.h"
+#include "libharry.h"
+
+/* Strings and lengths */
+static const char *strs[] = { "", "a", "ab", "kitten", "sitting", "a.b",
+    "a.c"
+};
+static size_t lens[] = { 0, 1, 2, 6, 7, 3, 3 };
+
+#define NUM     7
+
+/* Levenshtein distances of strings */
+static float lev[NUM][NUM] = {
+    {0, 1, 2, 6, 7, 3, 3},
+    {1, 0, 1, 6, 7, 2, 2},
+    {2, 1, 0, 6, 7, 1, 2},
+    {6, 6, 6, 0, 3, 6, 6},
+    {7, 7, 7, 3, 0, 7, 7},
+    {3, 2, 1, 6, 7, 0, 1},
+    {3, 2, 2, 6, 7, 1, 0},
+};
+
+/**
+ * Test comparison of all strings
+ * @return error flag
+ */
+int test_matrix()
+{
+    float m[NUM * NUM];
+    int i, j, err = FALSE;
+    harry_t *h;
+
+    printf("Testing matrix ");
+    h = harry_new("dist_levenshtein");
+    err |= !h || harry_compare(h, strs, lens, NUM, NULL, NULL, 0, m) != 0;
+
+    for (i = 0; i < NUM && !err; i++) {
+        for (j = 0; j < NUM && !err; j++) {
+            if (fabs(m[i * NUM + j] - lev[i][j]) > 1e-6) {
+                printf("Error %f != %f\n", m[i * NUM + j], lev[i][j]);
+                err = TRUE;
+            }
+        }
+        printf(".");
+    }
+
+    /* Rows and columns from different strings */
+    err |= harry_compare(h, strs + 3, lens + 3, 2, strs, lens, NUM, m) != 0;
+    for (i = 0; i < 2 && !err; i++) {
+        for (j = 0; j < NUM && !err; j++) {
+            if (fabs(m[i * NUM + j] - lev[i + 3][j]) > 1e-6) {
+                printf("Error %f != %f\n", m[i * NUM + j], lev[i + 3][j]);
+                err = TRUE;
+            }
+        }
+        printf(".");
+    }
+
+    harry_free(h);
+    printf(" done.\n");
+    return err;
+}
+
+/**
+ * Test settings and switching between handles
+ * @return error flag
+ */
+int test_settings()
+{
+    harry_t *h1, *h2;
+    float m1[4], m2[4];
+    int err = FALSE;
+
+    printf("Testing settings ");
+    h1 = harry_new(NULL);
+    h2 = harry_new("dist_hamming");
+
+    /* Settings not available in the library */
+    err |= harry_set(h1, "knn", "3") != -1;
+    err |= harry_set(h1, "num_threads", "x") != -1;
+    printf(".");
+
+    /* Tokens are preprocessed */
+    err |= harry_set(h2, "granularity", "tokens") != 0;
+    err |= harry_set(h2, "token_delim", ".") != 0;
+    err |= harry_set(h1, "norm", "max") != 0;
+    printf(".");
+
+    for (int i = 0; i < 2 && !err; i++) {
+        err |= harry_compare(h1, strs + 5, lens + 5, 2, NULL, NULL, 0, m1);
+        err |= harry_compare(h2, strs + 5, lens + 5, 2, NULL, NULL, 0, m2);
+        err |= fabs(m1[1] - 1 / 3.0) > 1e-6 || fabs(m2[1] - 1) > 1e-6;
+        printf(".");
+    }
+
+    if (err)
+        printf("Error %f %f\n", m1[1], m2[1]);
+
+    harry_free(h1);
+    harry_free(h2);
+    printf(" done.\n");
+    return err;
+}
+
+/**
+ * Main test function
+ */
+int main(int argc, char **argv)
+{
+    int err = FALSE;
+
+    err |= test_matrix();
+    err |= test_settings();
+
+    return err;
+}
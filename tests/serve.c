@@ -0,0 +1,316 @@
+/*
+ * Harry - A Tool for Measuring String Similarity
+ * Copyright (C) 2013-2015 Konrad Rieck (konrad@mlsec.org)
+ * --
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.  This program is distributed without any
+ * warranty. See the GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "common.h"
+#include "hconfig.h"
+#include "util.h"
+#include "measures.h"
+#include "hserve.h"
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+/* Global variables */
+int verbose = 0;
+config_t cfg;
+
+/* Strings of corpus */
+static char *strs[] = { "", "a", "ab", "kitten", "sitting", "a.b", "a.c" };
+
+#define NUM     7
+
+/* Levenshtein distances of strings */
+static float lev[NUM][NUM] = {
+    {0, 1, 2, 6, 7, 3, 3},
+    {1, 0, 1, 6, 7, 2, 2},
+    {2, 1, 0, 6, 7, 1, 2},
+    {6, 6, 6, 0, 3, 6, 6},
+    {7, 7, 7, 3, 0, 7, 7},
+    {3, 2, 1, 6, 7, 0, 1},
+    {3, 2, 2, 6, 7, 1, 0},
+};
+
+/* Address of socket */
+static struct sockaddr_un addr;
+
+/**
+ * Connect to the server. The server is started in a child process and
+ * thus the connection is retried for a while.
+ * @return socket or -1 on error
+ */
+static int client_connect()
+{
+    int i, fd;
+
+    for (i = 0; i < 500; i++) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+            return fd;
+        close(fd);
+        usleep(10000);
+    }
+
+    return -1;
+}
+
+/**
+ * Send a request header
+ * @param fd Socket
+ * @param magic Magic number
+ * @param type Type of request
+ * @param num Number of items
+ * @return true on success, false otherwise
+ */
+static int send_req(int fd, uint32_t magic, uint32_t type, uint32_t num)
+{
+    serve_req_t req = { magic, type, num };
+    return write(fd, &req, sizeof(req)) == sizeof(req);
+}
+
+/**
+ * Send a string as its length followed by the bytes
+ * @param fd Socket
+ * @param s String
+ * @return true on success, false otherwise
+ */
+static int send_str(int fd, char *s)
+{
+    uint32_t len = strlen(s);
+    return write(fd, &len, sizeof(len)) == sizeof(len) &&
+        write(fd, s, len) == len;
+}
+
+/**
+ * Receive a block of bytes
+ * @param fd Socket
+ * @param buf Buffer
+ * @param len Number of bytes
+ * @return true on success, false otherwise
+ */
+static int recv_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    ssize_t r;
+
+    while (len > 0) {
+        r = read(fd, p, len);
+        if (r <= 0)
+            return FALSE;
+        p += r;
+        len -= r;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Receive a reply and check its header
+ * @param fd Socket
+ * @param status Expected status
+ * @param num Expected number of values
+ * @param val Buffer for values
+ * @return error flag
+ */
+static int recv_rep(int fd, uint32_t status, uint64_t num, float *val)
+{
+    serve_rep_t rep;
+
+    if (!recv_full(fd, &rep, sizeof(rep))) {
+        printf("Error: no reply\n");
+        return TRUE;
+    }
+    if (rep.magic != SERVE_MAGIC || rep.status != status || rep.num != num) {
+        printf("Error: reply %x %u %lu != %x %u %lu\n", rep.magic,
+               rep.status, (unsigned long) rep.num, SERVE_MAGIC, status,
+               (unsigned long) num);
+        return TRUE;
+    }
+    if (status == SERVE_OK && val && !recv_full(fd, val, num * sizeof(float))) {
+        printf("Error: values missing\n");
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Compare received values with expected distances
+ * @param val Received values
+ * @param exp Expected values
+ * @param num Number of values
+ * @return error flag
+ */
+static int check_values(float *val, float *exp, long num)
+{
+    for (long i = 0; i < num; i++) {
+        if (fabs(val[i] - exp[i]) > 1e-6) {
+            printf("Error %f != %f\n", val[i], exp[i]);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Test requests with valid items
+ * @return error flag
+ */
+int test_requests()
+{
+    uint32_t idx[] = { 3, 4, 0, 6, 2, 5 };
+    float val[NUM], exp[NUM];
+    int i, fd, err = FALSE;
+
+    printf("Testing requests ");
+    fd = client_connect();
+    if (fd < 0) {
+        printf("Error: could not connect\n");
+        return TRUE;
+    }
+
+    /* Number of strings */
+    err |= !send_req(fd, SERVE_MAGIC, SERVE_INFO, 0);
+    err |= recv_rep(fd, SERVE_OK, NUM, NULL);
+    printf(".");
+
+    /* Pairs of indices */
+    err |= !send_req(fd, SERVE_MAGIC, SERVE_PAIRS, 3);
+    err |= write(fd, idx, sizeof(idx)) != sizeof(idx);
+    err |= recv_rep(fd, SERVE_OK, 3, val);
+    for (i = 0; i < 3 && !err; i++)
+        exp[i] = lev[idx[2 * i]][idx[2 * i + 1]];
+    err = err || check_values(val, exp, 3);
+    printf(".");
+
+    /* Pairs of strings */
+    err |= !send_req(fd, SERVE_MAGIC, SERVE_STRINGS, 2);
+    err |= !send_str(fd, "kitten") || !send_str(fd, "sitting");
+    err |= !send_str(fd, "") || !send_str(fd, "a.c");
+    err |= recv_rep(fd, SERVE_OK, 2, val);
+    exp[0] = lev[3][4], exp[1] = lev[0][6];
+    err = err || check_values(val, exp, 2);
+    printf(".");
+
+    /* Strings compared with corpus */
+    err |= !send_req(fd, SERVE_MAGIC, SERVE_ROWS, 2);
+    err |= !send_str(fd, "ab") || !send_str(fd, "sitting");
+    err |= recv_rep(fd, SERVE_OK, 2 * NUM, NULL);
+    err |= !recv_full(fd, val, NUM * sizeof(float));
+    err = err || check_values(val, lev[2], NUM);
+    err |= !recv_full(fd, val, NUM * sizeof(float));
+    err = err || check_values(val, lev[4], NUM);
+    printf(".");
+
+    close(fd);
+    printf(" done.\n");
+    return err;
+}
+
+/**
+ * Test requests answered with errors
+ * @return error flag
+ */
+int test_errors()
+{
+    uint32_t idx[] = { 0, NUM };
+    char c;
+    int fd, err = FALSE;
+
+    printf("Testing errors ");
+    fd = client_connect();
+    if (fd < 0) {
+        printf("Error: could not connect\n");
+        return TRUE;
+    }
+
+    /* Invalid index keeps connection */
+    err |= !send_req(fd, SERVE_MAGIC, SERVE_PAIRS, 1);
+    err |= write(fd, idx, sizeof(idx)) != sizeof(idx);
+    err |= recv_rep(fd, SERVE_EINVAL, 0, NULL);
+    err |= !send_req(fd, SERVE_MAGIC, SERVE_INFO, 0);
+    err |= recv_rep(fd, SERVE_OK, NUM, NULL);
+    printf(".");
+
+    /* Unknown type closes connection */
+    err |= !send_req(fd, SERVE_MAGIC, 42, 0);
+    err |= recv_rep(fd, SERVE_EINVAL, 0, NULL);
+    err |= read(fd, &c, 1) != 0;
+    close(fd);
+    printf(".");
+
+    /* Invalid magic number closes connection */
+    fd = client_connect();
+    err |= fd < 0 || !send_req(fd, 0, SERVE_INFO, 0);
+    err |= recv_rep(fd, SERVE_EINVAL, 0, NULL);
+    err |= read(fd, &c, 1) != 0;
+    close(fd);
+    printf(".");
+
+    /* Too many items closes connection */
+    fd = client_connect();
+    err |= fd < 0 || !send_req(fd, SERVE_MAGIC, SERVE_PAIRS, SERVE_ITEMS + 1);
+    err |= recv_rep(fd, SERVE_EINVAL, 0, NULL);
+    err |= read(fd, &c, 1) != 0;
+    close(fd);
+    printf(".");
+
+    printf(" done.\n");
+    return err;
+}
+
+/**
+ * Main test function
+ */
+int main(int argc, char **argv)
+{
+    int i, status, err = FALSE;
+    hstring_t s[NUM];
+    char *tmp;
+    pid_t pid;
+
+    tmp = getenv("TMPDIR");
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/harry-%d.sock",
+             tmp ? tmp : "/tmp", getpid());
+
+    config_init(&cfg);
+    config_check(&cfg);
+    measure_config("dist_levenshtein");
+
+    for (i = 0; i < NUM; i++) {
+        s[i] = hstring_init(s[i], strs[i]);
+        s[i] = hstring_preproc(s[i]);
+    }
+
+    /* Run server in child process */
+    pid = fork();
+    if (pid < 0)
+        return TRUE;
+    if (pid == 0)
+        exit(!hserve_run(addr.sun_path, s, NUM, measure_compare));
+
+    err |= test_requests();
+    err |= test_errors();
+
+    kill(pid, SIGTERM);
+    err |= waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0;
+
+    for (i = 0; i < NUM; i++)
+        hstring_destroy(&s[i]);
+    config_destroy(&cfg);
+    return err;
+}